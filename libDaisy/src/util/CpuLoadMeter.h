@@ -2,6 +2,7 @@
 
 #include "sys/system.h"
 #include <cmath>
+#include <cstddef>
 
 namespace daisy
 {
@@ -14,10 +15,26 @@ namespace daisy
  *  Then at the beginning of the audio callback, call `OnBlockStart()`, 
  *  and at the end of the audio callback, call `OnBlockEnd()`.
  *  You can then read out the minimum, maximum and average CPU load.
+ *
+ *  A single overloaded block barely moves the average but is an audible
+ *  click, so every block's load is also counted in a histogram, from which
+ *  percentiles can be estimated, and blocks that took longer than their
+ *  period are counted as overruns, with the times of the most recent ones.
+ *  The audio callback is the only writer. All readings can be taken from
+ *  the main loop without locking - a reading taken while a block ends may
+ *  or may not include that block.
  */
 class CpuLoadMeter
 {
   public:
+    /** Number of histogram buckets. They are evenly spaced from 0 to
+     *  kHistogramMaxLoad, and the last one also counts all higher loads. */
+    static constexpr size_t kNumHistogramBuckets = 128;
+    /** Load at the top of the histogram's range (1 = 100%). */
+    static constexpr float kHistogramMaxLoad = 2.0f;
+    /** Number of overrun times that are kept. */
+    static constexpr size_t kNumOverrunTimes = 8;
+
     CpuLoadMeter(){};
 
     /** Initializes the CpuLoadMeter for a particular sample rate and block size.
@@ -56,6 +73,22 @@ class CpuLoadMeter
         const auto currentBlockLoad
             = float(ticksPassed) * ticksPerBlockInv_; // usPassed / usPerBlock
 
+        // histogram - the top bucket also takes everything above its range
+        const float bucket = currentBlockLoad * kBucketsPerLoad;
+        const size_t bucketIdx = bucket < float(kNumHistogramBuckets - 1)
+                                     ? size_t(bucket)
+                                     : kNumHistogramBuckets - 1;
+        histogram_[bucketIdx] = histogram_[bucketIdx] + 1;
+
+        // overruns - the time is written before the count moves on, so a
+        // reader that sees the new count also sees its time
+        if(currentBlockLoad > 1.0f)
+        {
+            const uint32_t numOverruns = numOverruns_;
+            overrunTimes_[numOverruns % kNumOverrunTimes] = System::GetNow();
+            numOverruns_ = numOverruns + 1;
+        }
+
         if(firstCycle_)
         {
             max_ = min_ = avg_ = currentBlockLoad;
@@ -80,22 +113,108 @@ class CpuLoadMeter
     /** Returns the maximum CPU load observed since the last call to Reset(). */
     float GetMaxCpuLoad() const { return max_; }
 
-    /** Resets the minimun, maximum and average load readings. */
+    /** Estimates a percentile of the block loads observed since the last call
+     *  to Reset(), interpolating within the histogram bucket it falls in.
+     *  The estimate is within one bucket width (kHistogramMaxLoad /
+     *  kNumHistogramBuckets) of the true value, and never outside the
+     *  minimum and maximum load.
+     *  @param percentile   The percentile, 0..100, e.g. 99.9
+     *  @return The estimated load, or NAN if no blocks were measured
+     */
+    float GetCpuLoadPercentile(float percentile) const
+    {
+        // work on a copy, so the callback can't change it partway through
+        uint32_t counts[kNumHistogramBuckets];
+        uint32_t numBlocks = 0;
+        for(size_t i = 0; i < kNumHistogramBuckets; i++)
+        {
+            counts[i] = histogram_[i];
+            numBlocks += counts[i];
+        }
+        const float min = min_;
+        const float max = max_;
+        if(numBlocks == 0 || std::isnan(min) || std::isnan(max))
+            return NAN;
+
+        const float rank = percentile / 100.0f * float(numBlocks);
+        uint32_t    below = 0;
+        size_t      idx   = 0;
+        while(idx < kNumHistogramBuckets - 1 && float(below + counts[idx]) < rank)
+            below += counts[idx++];
+        float load;
+        if(idx == kNumHistogramBuckets - 1)
+            load = max; // the top bucket has no upper bound
+        else
+        {
+            const float fraction
+                = counts[idx] > 0 ? (rank - float(below)) / float(counts[idx])
+                                  : 0.0f;
+            load = (float(idx) + fraction) / kBucketsPerLoad;
+        }
+        return load < min ? min : (load > max ? max : load);
+    }
+
+    /** Returns the number of blocks that took longer than their period since
+     *  the last call to Reset(). */
+    uint32_t GetNumOverruns() const { return numOverruns_; }
+
+    /** Copies out the times of the most recent overruns, newest first.
+     *  @param dest     Receives the times, in ms as returned by System::GetNow()
+     *  @param maxNum   The most times to copy out
+     *  @return The number of times copied, at most kNumOverrunTimes
+     */
+    size_t GetOverrunTimes(uint32_t* dest, size_t maxNum) const
+    {
+        uint32_t numOverruns;
+        size_t   num;
+        // copy again if an overrun came in meanwhile, as it may have
+        // overwritten a time that was being copied
+        do
+        {
+            numOverruns = numOverruns_;
+            num         = numOverruns < kNumOverrunTimes ? numOverruns
+                                                         : kNumOverrunTimes;
+            num         = num < maxNum ? num : maxNum;
+            for(size_t i = 0; i < num; i++)
+                dest[i] = overrunTimes_[(numOverruns - 1 - i) % kNumOverrunTimes];
+        } while(numOverruns != numOverruns_);
+        return num;
+    }
+
+    /** Returns the number of blocks in a histogram bucket since the last call
+     *  to Reset(). Bucket i counts loads from i to i + 1 times
+     *  kHistogramMaxLoad / kNumHistogramBuckets. */
+    uint32_t GetHistogramCount(size_t bucket) const
+    {
+        return bucket < kNumHistogramBuckets ? histogram_[bucket] : 0;
+    }
+
+    /** Resets all load readings, the histogram and the overruns. */
     void Reset()
     {
         firstCycle_ = true;
         avg_ = max_ = min_ = NAN;
+        for(size_t i = 0; i < kNumHistogramBuckets; i++)
+            histogram_[i] = 0;
+        numOverruns_ = 0;
     }
 
   private:
     bool     firstCycle_;
     float    ticksPerBlockInv_;
     uint32_t currentBlockStartTicks_;
-    float    min_;
-    float    max_;
     float    avg_;
     float    smoothingConstant_;
 
+    static constexpr float kBucketsPerLoad
+        = float(kNumHistogramBuckets) / kHistogramMaxLoad;
+    float min_;
+    float max_;
+    // written by the audio callback and read from the main loop
+    volatile uint32_t histogram_[kNumHistogramBuckets];
+    volatile uint32_t numOverruns_;
+    volatile uint32_t overrunTimes_[kNumOverrunTimes];
+
     CpuLoadMeter(const CpuLoadMeter&) = delete;
     CpuLoadMeter& operator=(const CpuLoadMeter&) = delete;
 };
@@ -152,4 +152,142 @@ TEST(util_CpuLoadMeter, e_tolerateTickOverflow)
     // check results - meter should have tolerated the overflow
     EXPECT_FLOAT_EQ(meter.GetMinCpuLoad(), 0.5f);
     EXPECT_FLOAT_EQ(meter.GetMaxCpuLoad(), 0.5f);
-}
\ No newline at end of file
+}
+
+TEST(util_CpuLoadMeter, f_histogramStateAfterInit)
+{
+    CpuLoadMeter meter;
+    meter.Init(48000.0f, 48);
+    EXPECT_TRUE(std::isnan(meter.GetCpuLoadPercentile(50.0f)));
+    EXPECT_EQ(meter.GetNumOverruns(), 0u);
+    uint32_t times[4];
+    EXPECT_EQ(meter.GetOverrunTimes(times, 4), 0u);
+    for(size_t i = 0; i < CpuLoadMeter::kNumHistogramBuckets; i++)
+        EXPECT_EQ(meter.GetHistogramCount(i), 0u) << "in bucket " << i;
+}
+
+TEST(util_CpuLoadMeter, g_histogram)
+{
+    System::SetTickFreqForUnitTest(1000000u); // 1us tick duration
+    CpuLoadMeter meter;
+    meter.Init(48000.0f, 48); // 1kHz block rate
+
+    // 10%, 10%, 51% and 300% load - clear of the bucket edges
+    for(uint32_t us : {100u, 100u, 510u, 3000u})
+    {
+        meter.OnBlockStart();
+        System::SetTickForUnitTest(System::GetTick() + us);
+        meter.OnBlockEnd();
+    }
+
+    const float bucketWidth
+        = CpuLoadMeter::kHistogramMaxLoad / CpuLoadMeter::kNumHistogramBuckets;
+    EXPECT_EQ(meter.GetHistogramCount(size_t(0.1f / bucketWidth)), 2u);
+    EXPECT_EQ(meter.GetHistogramCount(size_t(0.51f / bucketWidth)), 1u);
+    // loads past the histogram's range land in the top bucket
+    EXPECT_EQ(meter.GetHistogramCount(CpuLoadMeter::kNumHistogramBuckets - 1),
+              1u);
+    uint32_t total = 0;
+    for(size_t i = 0; i < CpuLoadMeter::kNumHistogramBuckets; i++)
+        total += meter.GetHistogramCount(i);
+    EXPECT_EQ(total, 4u);
+    // out of range buckets read as empty
+    EXPECT_EQ(meter.GetHistogramCount(CpuLoadMeter::kNumHistogramBuckets), 0u);
+}
+
+TEST(util_CpuLoadMeter, h_percentiles)
+{
+    System::SetTickFreqForUnitTest(1000000u); // 1us tick duration
+    CpuLoadMeter meter;
+    meter.Init(48000.0f, 48); // 1kHz block rate
+
+    // 1000 blocks: mostly 20% load with a tail up to a single 105% block
+    const auto measure = [&meter](int numBlocks, uint32_t loadUs) {
+        for(int i = 0; i < numBlocks; i++)
+        {
+            meter.OnBlockStart();
+            System::SetTickForUnitTest(System::GetTick() + loadUs);
+            meter.OnBlockEnd();
+        }
+    };
+    measure(900, 200);
+    measure(90, 500);
+    measure(9, 800);
+    measure(1, 1050);
+
+    // estimates are within a bucket of the true percentile
+    const float bucketWidth
+        = CpuLoadMeter::kHistogramMaxLoad / CpuLoadMeter::kNumHistogramBuckets;
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(50.0f), 0.2f, bucketWidth);
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(95.0f), 0.5f, bucketWidth);
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(99.0f), 0.5f, bucketWidth);
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(99.5f), 0.8f, bucketWidth);
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(99.9f), 0.8f, bucketWidth);
+    // the average hides the overloaded block, the top percentile doesn't
+    EXPECT_LT(meter.GetAvgCpuLoad(), 1.0f);
+    EXPECT_NEAR(meter.GetCpuLoadPercentile(99.95f), 1.05f, bucketWidth);
+
+    // the ends are the minimum and maximum
+    EXPECT_FLOAT_EQ(meter.GetCpuLoadPercentile(0.0f), meter.GetMinCpuLoad());
+    EXPECT_FLOAT_EQ(meter.GetCpuLoadPercentile(100.0f), meter.GetMaxCpuLoad());
+
+    // a single load is its own percentile
+    meter.Reset();
+    measure(10, 300);
+    EXPECT_FLOAT_EQ(meter.GetCpuLoadPercentile(50.0f), 0.3f);
+    EXPECT_FLOAT_EQ(meter.GetCpuLoadPercentile(99.9f), 0.3f);
+
+    // a load past the histogram's range reads as the maximum
+    meter.Reset();
+    measure(1, 5000);
+    EXPECT_FLOAT_EQ(meter.GetCpuLoadPercentile(99.0f), 5.0f);
+}
+
+TEST(util_CpuLoadMeter, i_overruns)
+{
+    System::SetTickFreqForUnitTest(1000000u); // 1us tick duration
+    CpuLoadMeter meter;
+    meter.Init(48000.0f, 48); // 1kHz block rate
+
+    // runs one block at the given time in ms
+    const auto measure = [&meter](uint32_t nowMs, uint32_t loadUs) {
+        System::SetUsForUnitTest(nowMs * 1000);
+        meter.OnBlockStart();
+        System::SetTickForUnitTest(System::GetTick() + loadUs);
+        meter.OnBlockEnd();
+    };
+
+    // blocks within their period aren't overruns
+    measure(10, 500);
+    measure(11, 990);
+    EXPECT_EQ(meter.GetNumOverruns(), 0u);
+
+    measure(12, 1010);
+    measure(13, 500);
+    measure(14, 2000);
+    EXPECT_EQ(meter.GetNumOverruns(), 2u);
+    uint32_t times[CpuLoadMeter::kNumOverrunTimes + 2];
+    ASSERT_EQ(meter.GetOverrunTimes(times, 4), 2u);
+    // newest first
+    EXPECT_EQ(times[0], 14u);
+    EXPECT_EQ(times[1], 12u);
+    // no more than asked for
+    ASSERT_EQ(meter.GetOverrunTimes(times, 1), 1u);
+    EXPECT_EQ(times[0], 14u);
+
+    // only the most recent times are kept, but all overruns are counted
+    const size_t numTimes = CpuLoadMeter::kNumOverrunTimes;
+    for(uint32_t i = 0; i < numTimes + 3; i++)
+        measure(100 + i, 1500);
+    EXPECT_EQ(meter.GetNumOverruns(), numTimes + 5);
+    ASSERT_EQ(meter.GetOverrunTimes(times, numTimes + 2), numTimes);
+    for(size_t i = 0; i < numTimes; i++)
+        EXPECT_EQ(times[i], 100 + numTimes + 2 - i) << "at index " << i;
+
+    // reset clears the overruns
+    meter.Reset();
+    EXPECT_EQ(meter.GetNumOverruns(), 0u);
+    EXPECT_EQ(meter.GetOverrunTimes(times, numTimes), 0u);
+    for(size_t i = 0; i < CpuLoadMeter::kNumHistogramBuckets; i++)
+        EXPECT_EQ(meter.GetHistogramCount(i), 0u) << "in bucket " << i;
+}
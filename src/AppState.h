@@ -12,7 +12,9 @@ enum class AppState{
 enum class SynthMode{
   /* knob1 controls param 1, knob2 controls param 2 */
   Size_Position,        /* param 1 = grain size, param 2 = grain spawn position */
-  Pitch_ActiveGrains,   /* param 1 = grain pitch, param 2 = num of active grains */
+  Pitch_Density,        /* param 1 = grain pitch, param 2 = grain density (grains per second) */
+  Pan_Width,            /* param 1 = grain pan position, param 2 = pan jitter (stereo width) */
+  Window,               /* param 1 = Tukey window taper, param 2 unused */
   /* FX modes */
   Reverb,
   Filter
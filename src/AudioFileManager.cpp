@@ -177,49 +177,48 @@ bool AudioFileManager::GetWavHeader(FIL* file){
   return seek_res == FR_OK;
 }
 
-/// @brief Clear data buffers, check file length is within bounds, call audio loader
-/// @return True if audio is loaded, false if file is too long or incorrect bit depth
+/// @brief Clear the sample store, check file length is within bounds, call audio loader
+/// @return True if audio is loaded, false if file is too long or has too many channels
 bool AudioFileManager::LoadAudioData() {
-  memset(left_buf_, 0.0f, CHNL_BUF_SIZE_ABS);
-  memset(right_buf_, 0.0f, CHNL_BUF_SIZE_ABS);
+  store_->Clear();
+  if (header_.channels < 1 || header_.channels > 2) {
+    DebugPrint(pod_, "unsupported channel count %d", header_.channels);
+    return false;
+  }
+  store_->SetChannels(header_.channels);
   size_t samples_per_channel = GetSamplesPerChannel();
 
-  if (samples_per_channel > CHNL_BUF_SIZE_SAMPS) {
+  if (samples_per_channel > store_->MaxFrames()) {
     return false;
   }
-  return Load16BitAudio(samples_per_channel);
+  if (!Load16BitAudio(samples_per_channel)) return false;
+  if (mips_ && !mips_->Build(store_, store_->Length())){
+    DebugPrint(pod_, "mip-map not built, grains will read full rate audio only");
+  }
+  return true;
 }
 
-/// @brief Reads chunks of bytes from audio file into temporary buffer, then into SDRAM
+/// @brief Reads chunks of bytes from audio file straight into the sample store - 
+///        WAV data is already interleaved, so mono and stereo files need no conversion
 /// @param samples_per_channel Length of audio in samples, per channel 
 /// @return True if audio is loaded. False if file fails to read
 bool AudioFileManager::Load16BitAudio(size_t samples_per_channel){
   size_t samples_read = 0;
   UINT bytes_read;
-
-  std::vector<int16_t> temp_buff(BUF_CHUNK_SZ);
-
+  const size_t frame_bytes = header_.channels * sizeof(int16_t);
+  int16_t *dest = store_->Data();
 
   while (!f_eof(curr_file_) && samples_read<samples_per_channel){
     size_t samples_to_read = std::min(BUF_CHUNK_SZ, (samples_per_channel-samples_read));
-    size_t bytes_to_read = samples_to_read * header_.channels * sizeof(int16_t);
-    if (f_read(curr_file_, temp_buff.data(), bytes_to_read, &bytes_read)!=FR_OK){
+    size_t bytes_to_read = samples_to_read * frame_bytes;
+    if (f_read(curr_file_, dest + samples_read*header_.channels, bytes_to_read, &bytes_read)!=FR_OK){
       DebugPrint(pod_, "failed to read file from SD card");
       return false;
     }
-
-    size_t samples_in_chunk = bytes_read/(header_.channels*sizeof(int16_t));
-    for (size_t i=0; i<samples_in_chunk; i++){
-      if (header_.channels == 1){
-        left_buf_[i+samples_read] = right_buf_[i+samples_read] = temp_buff[i];
-      }
-      else {
-        left_buf_[i+samples_read] = temp_buff[i * 2];
-        right_buf_[i+samples_read] = temp_buff[i * 2 + 1];
-      }
-    }
-    samples_read += samples_in_chunk;
+    samples_read += bytes_read/frame_bytes;
+    if (bytes_read < bytes_to_read) break;
   }
+  store_->SetLength(samples_read);
   return true;
 }
 
@@ -230,10 +229,10 @@ bool AudioFileManager::CloseFile(){
   return f_close(curr_file_) == FR_OK;
 }
 
-/// @brief Assign the locations of the audio data buffers
-/// @param left Pointer to the left channel buffer
-/// @param right Pointer to the right channel buffer
-void AudioFileManager::SetBuffers(int16_t *left, int16_t *right){
-  left_buf_ = left;
-  right_buf_ = right;
+/// @brief Assign the sample store audio files are loaded into
+/// @param store Pointer to the master sample store
+/// @param mips Mip-map built from each loaded file, or nullptr to skip building one
+void AudioFileManager::SetSampleStore(SampleStore *store, SampleMipMap *mips){
+  store_ = store;
+  mips_ = mips;
 }
@@ -4,6 +4,8 @@
 #include <vector>
 #include "daisy_pod.h"
 #include "constants_utils.h"
+#include "SampleStore.h"
+#include "SampleMipMap.h"
 #include "debug_print.h"
 
 using namespace daisy; 
@@ -12,19 +14,19 @@ class AudioFileManager {
   public:
     AudioFileManager(SdmmcHandler &sd, FatFSInterface &fsi, DaisyPod &pod, FIL *file)
       : sd_(sd), fsi_(fsi), pod_(pod), curr_file_(file), 
-        left_buf_(nullptr), right_buf_(nullptr) {};
+        store_(nullptr), mips_(nullptr) {};
     
     bool Init();
     bool ScanWavFiles();
-    void SetBuffers(int16_t *left, int16_t *right);
+    void SetSampleStore(SampleStore *store, SampleMipMap *mips=nullptr);
     bool LoadFile(uint16_t file_idx);
     
     bool CloseFile();
     bool GetWavHeader(FIL *file);
 
-    int16_t* GetLeftBuffer() const { return left_buf_; }
-    int16_t* GetRightBuffer() const { return right_buf_; }
-    size_t GetSamplesPerChannel() const { return header_.total_samples / header_.channels; }
+    SampleStore* GetSampleStore() const { return store_; }
+    /* 0 until a file has loaded */
+    size_t GetSamplesPerChannel() const { return header_.channels > 0 ? header_.total_samples / header_.channels : 0; }
     size_t GetTotalSamples() const { return header_.total_samples; }
     int16_t GetNumChannels() const { return header_.channels; }
     uint16_t GetFileCount() const { return file_count_; }
@@ -52,9 +54,10 @@ class AudioFileManager {
     FatFSInterface& fsi_;
     DaisyPod& pod_;
     FIL* curr_file_; 
-    /* pointers to master left/right channel buffers */
-    int16_t* left_buf_;
-    int16_t* right_buf_;
+    /* master audio store the file is loaded into */
+    SampleStore* store_;
+    /* decimated levels built from each loaded file, optional */
+    SampleMipMap* mips_;
     /* list of filenames for logging */
     char names_ [MAX_FILES][MAX_FNAME_LEN];
     /* index of currently selected file */
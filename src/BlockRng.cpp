@@ -0,0 +1,21 @@
+#include "BlockRng.h"
+
+/* 32 bit SplitMix - spreads a seed over the generator state, so nearby seeds
+  still give unrelated streams */
+static inline uint32_t SplitMix32(uint32_t &x){
+  uint32_t z = (x += 0x9E3779B9u);
+  z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+  return z ^ (z >> 16);
+}
+
+/// @brief Restarts every lane from a seed
+/// @param seed Any value - the same seed always gives the same numbers
+void BlockRng::Seed(uint32_t seed){
+  for (size_t l=0; l<kLanes; l++){
+    for (size_t w=0; w<4; w++) s_[w][l] = SplitMix32(seed);
+    /* an all zero state only ever gives zeros */
+    if ((s_[0][l] | s_[1][l] | s_[2][l] | s_[3][l]) == 0) s_[0][l] = 1;
+  }
+  cached_ = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "constants_utils.h"
+#include <string.h>
+
+/* Random numbers for the audio callback, made a block at a time.
+  kLanes xoshiro128+ generators (https://prng.di.unimi.it/) run side by side
+  with their state stored lane by lane, so every step is the same shifts and
+  xors across all lanes - the lane loops vectorise on the host and unroll
+  without branches on the M7. Floats are made by putting the top 23 bits of
+  a draw into the mantissa of a float in [1,2), so there is no divide (the
+  low bits of xoshiro128+ are its weakest and are thrown away).
+  Each instance has its own state and the same seed always gives the same
+  numbers, so renders are reproducible */
+class BlockRng {
+  public:
+    static constexpr size_t kLanes = 4;
+
+    BlockRng() { Seed(1); }
+
+    void Seed(uint32_t seed);
+
+    /* [0, 1) */
+    void FillUniform(float *out, size_t n) { FillSum<1>(out, n, 1.0f, 0.0f); }
+    /* [-1, 1) */
+    void FillBipolar(float *out, size_t n) { FillSum<1>(out, n, 2.0f, -1.0f); }
+    /* (-1, 1), peaking at 0 - the sum of two uniforms */
+    void FillTriangular(float *out, size_t n) { FillSum<2>(out, n, 1.0f, -1.0f); }
+    /* approximately normal, mean 0 and standard deviation 1 - the sum of four
+      uniforms, so it never strays past +-3.46 */
+    void FillGaussian(float *out, size_t n) { FillSum<4>(out, n, 1.7320508f, -3.4641016f); }
+
+    /* single uniform in [0, 1), for the odd value outside a block */
+    float Uniform(){
+      if (cached_ == 0){
+        Next(cache_);
+        cached_ = kLanes;
+      }
+      return ToUnit(cache_[--cached_]);
+    }
+
+  private:
+    static inline uint32_t Rotl(uint32_t x, int k){
+      return (x << k) | (x >> (32 - k));
+    }
+
+    static inline float ToUnit(uint32_t x){
+      uint32_t bits = (x >> 9) | 0x3F800000u;
+      float f;
+      memcpy(&f, &bits, sizeof(f));
+      return f - 1.0f;
+    }
+
+    /* one xoshiro128+ step of every lane */
+    inline void Next(uint32_t *out){
+      for (size_t l=0; l<kLanes; l++){
+        out[l] = s_[0][l] + s_[3][l];
+        const uint32_t t = s_[1][l] << 9;
+        s_[2][l] ^= s_[0][l];
+        s_[3][l] ^= s_[1][l];
+        s_[1][l] ^= s_[2][l];
+        s_[0][l] ^= s_[3][l];
+        s_[2][l] ^= t;
+        s_[3][l] = Rotl(s_[3][l], 11);
+      }
+    }
+
+    /* out[i] = (sum of kDraws uniforms) * scale + offset */
+    template <size_t kDraws>
+    void FillSum(float *out, size_t n, float scale, float offset){
+      uint32_t r[kLanes];
+      float sum[kLanes];
+      for (size_t i=0; i<n; i+=kLanes){
+        for (size_t l=0; l<kLanes; l++) sum[l] = 0.0f;
+        for (size_t d=0; d<kDraws; d++){
+          Next(r);
+          for (size_t l=0; l<kLanes; l++) sum[l] += ToUnit(r[l]);
+        }
+        const size_t count = n - i < kLanes ? n - i : kLanes;
+        for (size_t l=0; l<count; l++) out[i+l] = sum[l] * scale + offset;
+      }
+    }
+
+    /* state word w of lane l is s_[w][l] */
+    uint32_t s_[4][kLanes];
+    uint32_t cache_[kLanes];
+    size_t cached_;
+};
@@ -1,19 +1,82 @@
 #include "ChordMode.h"
 
+/* notes of a chord or scale as semitones above the root */
+struct NoteShape{
+  size_t count;
+  uint8_t intervals[MAX_CHORD_NOTES];
+};
+
+/* indexed by ChordType */
+static constexpr NoteShape kChordShapes[] = {
+  {3, {0,4,7}},         /* Major triad */
+  {4, {0,4,7,11}},      /* Major 7th */
+  {3, {0,3,7}},         /* minor triad */
+  {4, {0,3,7,10}},      /* minor 7th */
+  {4, {0,4,7,10}},      /* dominant 7th */
+  {5, {0,4,7,11,14}},   /* Major 9th */
+  {5, {0,3,7,10,14}},   /* minor 9th */
+  {3, {0,2,7}},         /* sus2 */
+  {3, {0,5,7}}          /* sus4 */
+};
+
+/* indexed by ScaleType */
+static constexpr NoteShape kScaleShapes[] = {
+  {7, {0,2,4,5,7,9,11}},  /* Major scale */
+  {7, {0,2,3,5,7,8,10}},  /* Natural Minor scale */
+  {7, {0,2,3,5,7,8,11}},  /* Harmonic Minor scale */
+  {7, {0,2,3,5,7,9,11}}   /* Melodic Minor scale */
+};
+
+static_assert(sizeof(kChordShapes) / sizeof(NoteShape) == static_cast<size_t>(ChordType::NUM_CHORDS),
+              "every chord type needs a shape");
+static_assert(sizeof(kScaleShapes) / sizeof(NoteShape) == static_cast<size_t>(ScaleType::NUM_SCALES),
+              "every scale type needs a shape");
+
+/* one octave of pitch ratios, 2^(n/12) and the 5-limit just ratios
+  https://en.wikipedia.org/wiki/Five-limit_tuning */
+static constexpr float kEqualRatios[12] = {
+  1.000000000f, 1.059463094f, 1.122462048f, 1.189207115f, 1.259921050f, 1.334839854f,
+  1.414213562f, 1.498307077f, 1.587401052f, 1.681792831f, 1.781797436f, 1.887748625f
+};
+static constexpr float kJustRatios[12] = {
+  1.0f, 16.0f/15.0f, 9.0f/8.0f, 6.0f/5.0f, 5.0f/4.0f, 4.0f/3.0f,
+  45.0f/32.0f, 3.0f/2.0f, 8.0f/5.0f, 5.0f/3.0f, 9.0f/5.0f, 15.0f/8.0f
+};
+
+/* ratio of any number of semitones from an octave table - every octave up doubles it */
+static constexpr float IntervalRatio(const float *table, size_t semitones){
+  return table[semitones % 12] * static_cast<float>(1u << (semitones / 12));
+}
 
+static_assert(IntervalRatio(kEqualRatios, 19) == 1.498307077f * 2.0f, "ratio tables are constexpr");
 
 void ChordMode::CycleChord(){
   size_t mode_idx = static_cast<size_t>(chord_state_.curr_chord_);
   mode_idx++;
-  if (mode_idx>3) mode_idx = 0;
+  if (mode_idx >= static_cast<size_t>(ChordType::NUM_CHORDS)) mode_idx = 0;
   chord_state_.curr_chord_= static_cast<ChordType>(mode_idx);
+  /* the new chord may have fewer notes */
+  SetInversion(chord_state_.inversion_);
 }
 
 void ChordMode::CycleScale(){
   size_t mode_idx = static_cast<size_t>(chord_state_.curr_scale_);
   mode_idx++;
-  if (mode_idx>3) mode_idx = 0;
+  if (mode_idx >= static_cast<size_t>(ScaleType::NUM_SCALES)) mode_idx = 0;
   chord_state_.curr_scale_= static_cast<ScaleType>(mode_idx);
+  chord_state_.curr_step_ = 0;
+}
+
+/// @brief Jumps straight to a chord type, eg from an offline render timeline
+void ChordMode::SetChord(ChordType chord){
+  chord_state_.curr_chord_ = chord;
+  SetInversion(chord_state_.inversion_);
+}
+
+/// @brief Jumps straight to a scale, restarting from its first step
+void ChordMode::SetScale(ScaleType scale){
+  chord_state_.curr_scale_ = scale;
+  chord_state_.curr_step_ = 0;
 }
 
 /* sets the root note / key */
@@ -22,6 +85,20 @@ void ChordMode::SetKey(size_t key){
   // chord_state_.key_ = key%12;
 }
 
+/// @brief Sets how many notes, from the bottom of the chord, are moved up an octave
+/// @param inversion 0 for root position, wraps round at the number of notes in the chord
+void ChordMode::SetInversion(size_t inversion){
+  chord_state_.inversion_ = inversion % kChordShapes[static_cast<size_t>(chord_state_.curr_chord_)].count;
+}
+
+/// @brief Steps the inversion by increment, wrapping round in both directions
+void ChordMode::CycleInversion(int32_t increment){
+  int32_t count = static_cast<int32_t>(kChordShapes[static_cast<size_t>(chord_state_.curr_chord_)].count);
+  int32_t idx = (static_cast<int32_t>(chord_state_.inversion_) + increment) % count;
+  if (idx < 0) idx += count;
+  SetInversion(static_cast<size_t>(idx));
+}
+
 void ChordMode::CyclePlaybackMode(){
   int mode_idx = static_cast<int>(chord_state_.playback_mode_);
   mode_idx++;
@@ -30,125 +107,123 @@ void ChordMode::CyclePlaybackMode(){
   chord_state_.curr_step_ = 0;
 }
 
-float ChordMode::SemitoneToRatio(size_t semitones){
-  return pow(2.0f, ((chord_state_.key_ + semitones)/12.0f));
+/// @brief Pitch ratio of a note above the key - the key is always equal tempered,
+///        the interval above it follows the tuning. Two table lookups, no pow
+/// @param semitones Interval above the key
+float ChordMode::SemitoneToRatio(size_t semitones) const {
+  const float *table = chord_state_.tuning_ == Tuning::Just ? kJustRatios : kEqualRatios;
+  return IntervalRatio(kEqualRatios, chord_state_.key_) * IntervalRatio(table, semitones);
 }
 
-std::vector<float> ChordMode::GetRatios(size_t direction){
+/// @brief Generates the pitch ratios for the next encoder step in the current playback mode
+/// @param direction Encoder increment - steps through the scale / arpeggio, unused for chords
+ChordRatios ChordMode::GetRatios(int32_t direction){
+  ChordRatios ratios;
+  ratios.Clear();
   switch(chord_state_.playback_mode_){
     case ChordPlaybackMode::Chord:
-      GenerateChord();
+      GenerateChord(ratios);
       break;
     case ChordPlaybackMode::Scale:
-      GenerateScale(direction);
+      GenerateScale(direction, ratios);
       break;
     case ChordPlaybackMode::Arpeggio:
-      GenerateArp(direction);
+      GenerateArp(direction, ratios);
       break;
   }
-  return ratios_;
-}
-
-/* returns ratios of all notes in chord */
-void ChordMode::GenerateChord(){
-  ratios_.clear();
-  /* get semitone positions for current chord */
-  std::vector<size_t> curr_chord = chord_intervals_[static_cast<size_t>(chord_state_.curr_chord_)];
-  for (size_t i=0; i<curr_chord.size();i++){
-    /* get the semitone position for this note in chord, eg 0 / 4 /7 etc
-      and find transposition by adding this to root note of key */
-    size_t semitones = curr_chord[i] + chord_state_.key_;
-    /* we do 2 ^ (note/12) to get correct pitch ratio for note
-      since 1 semitone increases freq by [freq * 2^(1/12)]  */
-    float pitch_ratio = SemitoneToRatio(semitones);
-    ratios_.push_back(pitch_ratio);
-  }
+  return ratios;
 }
 
-/* returns ratio of next note in scale */
-void ChordMode::GenerateScale(size_t direction){
-  ratios_.clear();
-  std::vector<size_t> curr_scale = scale_intervals_[static_cast<int>(chord_state_.curr_scale_)];
-  /* increment by direction, make sure it stays within scale bounds */
-  chord_state_.curr_step_ += direction;
-  if (chord_state_.curr_step_ > curr_scale.size()){
-    chord_state_.curr_step_ =0;
-  }
-  else if (chord_state_.curr_step_ < 0){
-    chord_state_.curr_step_ = curr_scale.size()-1;
-  }
-  /* get semitone position of next note in scale */
-  size_t next_ratio = SemitoneToRatio(chord_state_.curr_step_);
-  ratios_.push_back(next_ratio);
-}
-
-/* returns ratio of next note in chord */
-void ChordMode::GenerateArp(size_t direction){
-  ratios_.clear();
-  std::vector<size_t> curr_chord = scale_intervals_[static_cast<size_t>(chord_state_.curr_chord_)];
-  /* ensure it stays within chord bounds  */
-  chord_state_.curr_step_ += direction;
-  if (chord_state_.curr_step_ > curr_chord.size()){
-    chord_state_.curr_step_ =0;
-  }
-  else if (chord_state_.curr_step_ < 0){
-    chord_state_.curr_step_ = curr_chord.size()-1;
+/// @brief Semitones above the key of a chord note, in order from the bottom once
+///        the inversion has moved the lowest notes up an octave
+size_t ChordMode::ChordInterval(size_t note) const {
+  const NoteShape &chord = kChordShapes[static_cast<size_t>(chord_state_.curr_chord_)];
+  size_t idx = note + chord_state_.inversion_;
+  if (idx < chord.count) return chord.intervals[idx];
+  return chord.intervals[idx - chord.count] + 12;
+}
+
+/// @brief Moves the scale / arpeggio step by direction, wrapping round in both directions
+/// @param count Number of steps before wrapping
+/// @return The new step
+size_t ChordMode::Step(int32_t direction, size_t count){
+  int32_t n = static_cast<int32_t>(count);
+  int32_t step = (static_cast<int32_t>(chord_state_.curr_step_) + direction) % n;
+  if (step < 0) step += n;
+  chord_state_.curr_step_ = static_cast<size_t>(step);
+  return chord_state_.curr_step_;
+}
+
+/* ratios of all notes in chord */
+void ChordMode::GenerateChord(ChordRatios &ratios) const {
+  const size_t count = kChordShapes[static_cast<size_t>(chord_state_.curr_chord_)].count;
+  for (size_t i=0; i<count; i++){
+    ratios.Push(SemitoneToRatio(ChordInterval(i)));
   }
-  /* get semitone position of next note in chord */
-  size_t next_ratio = SemitoneToRatio(chord_state_.curr_step_);
-  ratios_.push_back(next_ratio);
 }
 
-ChordPlaybackMode ChordMode::GetMode(){
-  return chord_state_.playback_mode_;
+/* ratio of next note in scale */
+void ChordMode::GenerateScale(int32_t direction, ChordRatios &ratios){
+  const NoteShape &scale = kScaleShapes[static_cast<size_t>(chord_state_.curr_scale_)];
+  size_t step = Step(direction, scale.count);
+  ratios.Push(SemitoneToRatio(scale.intervals[step]));
 }
 
-std::string ChordMode::GetModeName(){
-  std::string s;
+/* ratio of next note in chord */
+void ChordMode::GenerateArp(int32_t direction, ChordRatios &ratios){
+  const size_t count = kChordShapes[static_cast<size_t>(chord_state_.curr_chord_)].count;
+  size_t step = Step(direction, count);
+  ratios.Push(SemitoneToRatio(ChordInterval(step)));
+}
+
+const char* ChordMode::GetModeName() const {
   switch(chord_state_.playback_mode_){
     case ChordPlaybackMode::Arpeggio:
-      s = "switched to Arpeggio mode";
-      break;
+      return "switched to Arpeggio mode";
     case ChordPlaybackMode::Chord:
-      s = "switched to Chord mode";
-      break;
+      return "switched to Chord mode";
     case ChordPlaybackMode::Scale:
-      s = "switched to Scale mode";
-      break;
+      return "switched to Scale mode";
   }
-  return s;
+  return "";
 }
 
-std::string ChordMode::GetScaleName(){
-  std::string s;
+const char* ChordMode::GetScaleName() const {
   switch(chord_state_.curr_scale_){
     case ScaleType::Major:
-      s = "switched to Major scale";
+      return "switched to Major scale";
     case ScaleType::NaturalMinor:
-      s = "switched to Natural Minor scale";
+      return "switched to Natural Minor scale";
     case ScaleType::HarmonicMinor:
-      s = "switched to Harmonic Minor scale";
+      return "switched to Harmonic Minor scale";
     case ScaleType::MelodicMinor:
-      s = "switched to Melodic Minor scale";
+      return "switched to Melodic Minor scale";
+    default:
+      return "";
   }
-  return s;
 }
 
-std::string ChordMode::GetChordName(){
-  std::string s;
+const char* ChordMode::GetChordName() const {
   switch (chord_state_.curr_chord_){
     case ChordType::Major:
-      s = "switched to Major chord";
+      return "switched to Major chord";
     case ChordType::Major7th:
-      s = "switched to Maj7th chord";
+      return "switched to Maj7th chord";
     case ChordType::Minor:
-      s = "switched to Minor chord";
+      return "switched to Minor chord";
     case ChordType::Minor7th:
-      s = "switched to Min7th chord";
+      return "switched to Min7th chord";
+    case ChordType::Dominant7th:
+      return "switched to Dom7th chord";
+    case ChordType::Major9th:
+      return "switched to Maj9th chord";
+    case ChordType::Minor9th:
+      return "switched to Min9th chord";
+    case ChordType::Sus2:
+      return "switched to Sus2 chord";
+    case ChordType::Sus4:
+      return "switched to Sus4 chord";
+    default:
+      return "";
   }
-  return s;
 }
-
-size_t ChordMode::GetStep(){
-  return chord_state_.curr_step_;
-}
\ No newline at end of file
@@ -1,9 +1,6 @@
 #pragma once
 
-#include "daisysp.h"
-#include <array>
-
-using namespace daisysp;
+#include "constants_utils.h"
 
 // https://www.sacred-geometry.es/?q=en/content/proportion-musical-scales
 /* https://ianring.com/musictheory/scales/finder/ */
@@ -12,14 +9,21 @@ enum class ScaleType{
   Major,
   NaturalMinor,
   HarmonicMinor,
-  MelodicMinor
+  MelodicMinor,
+  NUM_SCALES
 };
 
 enum class ChordType{
   Major,
   Major7th,
   Minor,
-  Minor7th
+  Minor7th,
+  Dominant7th,
+  Major9th,
+  Minor9th,
+  Sus2,
+  Sus4,
+  NUM_CHORDS
 };
 
 enum class ChordPlaybackMode{
@@ -28,61 +32,69 @@ enum class ChordPlaybackMode{
   Scale
 };
 
+/* how intervals above the root are tuned - the root itself always follows the key in 12-TET */
+enum class Tuning{
+  Equal,  /* 12 tone equal temperament */
+  Just    /* 5-limit just intonation */
+};
+
+/* Pitch ratios of a chord, or of the single note of a scale / arpeggio step.
+  Fixed capacity and stored inline, so it is passed around by value and never
+  touches the heap */
+struct ChordRatios{
+  float ratios[MAX_CHORD_NOTES];
+  size_t count;
+
+  void Clear() { count = 0; }
+  /* notes past MAX_CHORD_NOTES are dropped */
+  void Push(float ratio) { if (count < MAX_CHORD_NOTES) ratios[count++] = ratio; }
+  size_t size() const { return count; }
+  float operator[](size_t i) const { return ratios[i]; }
+};
+
 class ChordMode{
   public:
     ChordMode(){}
 
     void SetKey(size_t key);
+    void SetTuning(Tuning tuning) { chord_state_.tuning_ = tuning; }
+    void SetInversion(size_t inversion);
+    void SetChord(ChordType chord);
+    void SetScale(ScaleType scale);
     void CycleScale();
     void CycleChord();
+    void CycleInversion(int32_t increment);
     void CyclePlaybackMode();
-    float SemitoneToRatio(size_t semitones);    
-
-    void GenerateChord();
-    void GenerateScale(size_t direction);
-    void GenerateArp(size_t direction);
-
-    std::vector<float> GetRatios(size_t direction);
+    float SemitoneToRatio(size_t semitones) const;
 
-    ChordPlaybackMode GetMode();
-    std::string GetModeName();
-    std::string GetScaleName();
-    std::string GetChordName();
-    size_t GetStep();
+    ChordRatios GetRatios(int32_t direction);
 
-    char temp_str[10];
+    ChordPlaybackMode GetMode() const { return chord_state_.playback_mode_; }
+    Tuning GetTuning() const { return chord_state_.tuning_; }
+    size_t GetInversion() const { return chord_state_.inversion_; }
+    const char* GetModeName() const;
+    const char* GetScaleName() const;
+    const char* GetChordName() const;
+    size_t GetStep() const { return chord_state_.curr_step_; }
 
   private:
-    static const int MAX_CHORD_NOTES = 8; 
-    static const int MAX_SCALE_NOTES = 8;
-
     struct ChordState{
       ScaleType curr_scale_ = ScaleType::Major;
       ChordType curr_chord_ = ChordType::Major;
       ChordPlaybackMode playback_mode_ =  ChordPlaybackMode::Chord;
+      Tuning tuning_ = Tuning::Equal;
       size_t key_ = 0;
+      /* notes of the chord moved up an octave, from the bottom */
+      size_t inversion_ = 0;
       /* current step in arpeggio / scale */
-      size_t curr_step_ = 0; 
+      size_t curr_step_ = 0;
     };
 
-    ChordState chord_state_;
-    std::vector<float> ratios_;
-
-    
+    void GenerateChord(ChordRatios &ratios) const;
+    void GenerateScale(int32_t direction, ChordRatios &ratios);
+    void GenerateArp(int32_t direction, ChordRatios &ratios);
+    size_t ChordInterval(size_t note) const;
+    size_t Step(int32_t direction, size_t count);
 
-    const std::array<std::vector<size_t>, 4> chord_intervals_ = 
-    {{
-      {0,4,7}, /* Major triad */
-      {0,3,7}, /* minor triad */
-      {0,4,7,11}, /* Major 7th */
-      {0,3,7,10} /* Minor 7th */
-    }};
-
-    const std::array<std::vector<size_t>,4> scale_intervals_ = 
-    {{
-      {0,2,4,5,7,9,11}, /* Major scale */
-      {0,2,3,5,7,8,10}, /* Natural Minor scale */
-      {0,2,3,5,7,8,11}, /* Harmonic Minor scale */
-      {0,2,3,5,7,9,11} /* Melodic Minor scale */
-    }};
-};
\ No newline at end of file
+    ChordState chord_state_;
+};
@@ -41,6 +41,7 @@ static int DelayLineMaxSamples(float sr, float i_pitch_mod, int n);
 static int         DelayLineBytesAlloc(float sr, float i_pitch_mod, int n);
 static const float kOutputGain = 0.35;
 static const float kJpScale    = 0.25;
+static const size_t kMinLaneBlock = 8;
 
 int ReverbSc::Init(float sr)
 {
@@ -139,6 +140,18 @@ int ReverbSc::InitDelayLine(ReverbScDl *lp, int n)
     return REVSC_OK;
 }
 
+/* calculate tone filter coefficient if frequency changed */
+void ReverbSc::UpdateDampFact()
+{
+    if(lpfreq_ != prv_lpfreq_)
+    {
+        prv_lpfreq_ = lpfreq_;
+        float damp_fact
+            = 2.0f - cosf(prv_lpfreq_ * (2.0f * (float)M_PI) / sample_rate_);
+        damp_fact_ = damp_fact - sqrtf(damp_fact * damp_fact - 1.0f);
+    }
+}
+
 int ReverbSc::Process(const float &in1,
                       const float &in2,
                       float *      out1,
@@ -156,15 +169,8 @@ int ReverbSc::Process(const float &in1,
     if(init_done_ <= 0)
         return REVSC_NOT_OK;
 
-    /* calculate tone filter coefficient if frequency changed */
-    if(lpfreq_ != prv_lpfreq_)
-    {
-        prv_lpfreq_ = lpfreq_;
-        damp_fact
-            = 2.0f - cosf(prv_lpfreq_ * (2.0f * (float)M_PI) / sample_rate_);
-        damp_fact = damp_fact_
-            = damp_fact - sqrtf(damp_fact * damp_fact - 1.0f);
-    }
+    UpdateDampFact();
+    damp_fact = damp_fact_;
 
     /* calculate "resultant junction pressure" and mix to input signals */
 
@@ -288,4 +294,193 @@ void ReverbSc::ProcessMix(const float &in1, const float &in2, float *out1, float
   Process(in1, in2, &wet_out1, &wet_out2);
   *out1 = wet_mix_*wet_out1 + ((1.0f-wet_mix_)*in1);
   *out2 = wet_mix_*wet_out2 + ((1.0f-wet_mix_)*in2);
-}
\ No newline at end of file
+}
+
+int ReverbSc::ProcessBlock(const float *in1,
+                           const float *in2,
+                           float *      out1,
+                           float *      out2,
+                           size_t       size)
+{
+    if(init_done_ <= 0)
+        return REVSC_NOT_OK;
+
+    /* copying the lanes in and out costs more than it saves on a few frames */
+    if(size < kMinLaneBlock)
+    {
+        for(size_t i = 0; i < size; i++)
+            Process(in1[i], in2[i], &out1[i], &out2[i]);
+        return REVSC_OK;
+    }
+
+    /* the tone filter can only change between calls */
+    UpdateDampFact();
+    const float damp_fact = damp_fact_;
+    const float feedback  = feedback_;
+
+    /* lane state - the delay lines copied into arrays for the block, so the
+       frame loop keeps them in registers and cache rather than going back to
+       the structs after every store into a delay buffer. The junction couples
+       every line each frame, so the lanes step together a frame at a time.
+       The arithmetic is Process's, term for term, so the output is bit for
+       bit the same */
+    float *buf[8];
+    int    buffer_size[8], write_pos[8], read_pos[8], read_pos_frac[8];
+    int    read_pos_frac_inc[8], rand_line_cnt[8];
+    float  filter_state[8];
+    for(int n = 0; n < 8; n++)
+    {
+        buf[n]               = delay_lines_[n].buf;
+        buffer_size[n]       = delay_lines_[n].buffer_size;
+        write_pos[n]         = delay_lines_[n].write_pos;
+        read_pos[n]          = delay_lines_[n].read_pos;
+        read_pos_frac[n]     = delay_lines_[n].read_pos_frac;
+        read_pos_frac_inc[n] = delay_lines_[n].read_pos_frac_inc;
+        rand_line_cnt[n]     = delay_lines_[n].rand_line_cnt;
+        filter_state[n]      = delay_lines_[n].filter_state;
+    }
+
+    size_t i = 0;
+    while(i < size)
+    {
+        /* run up to the next random line segment, so the counts are only
+           checked once per run rather than on every frame */
+        int run = (int)(size - i < 0x7FFFFFFF ? size - i : 0x7FFFFFFF);
+        for(int n = 0; n < 8; n++)
+            if(rand_line_cnt[n] < run)
+                run = rand_line_cnt[n];
+        if(run < 1)
+            run = 1;
+        const size_t run_end = i + run;
+
+        for(; i < run_end; i++)
+        {
+            /* "resultant junction pressure", summed in line order as in Process */
+            float a_in_l = 0.0;
+            for(int n = 0; n < 8; n++)
+                a_in_l += filter_state[n];
+            a_in_l *= kJpScale;
+            float a_in_r = a_in_l + in2[i];
+            a_in_l       = a_in_l + in1[i];
+
+            /* then each line in turn - write the input and feedback, move the
+               read position on and read it back with cubic interpolation, then
+               feedback gain and the lowpass filter */
+            for(int n = 0; n < 8; n++)
+            {
+                float *   lbuf   = buf[n];
+                const int size_n = buffer_size[n];
+                lbuf[write_pos[n]]
+                    = (float)((n & 1 ? a_in_r : a_in_l) - filter_state[n]);
+                write_pos[n] = write_pos[n] + 1 >= size_n ? 0 : write_pos[n] + 1;
+
+                /* the fraction is never negative, so its whole part is 0
+                   whenever Process would skip this */
+                int rp = read_pos[n] + (read_pos_frac[n] >> DELAYPOS_SHIFT);
+                int rf = read_pos_frac[n] & DELAYPOS_MASK;
+                if(rp >= size_n)
+                    rp -= size_n;
+                read_pos[n] = rp;
+
+                float vm1, v0, v1, v2;
+                if(rp > 0 && rp < (size_n - 2))
+                {
+                    vm1 = lbuf[rp - 1];
+                    v0  = lbuf[rp];
+                    v1  = lbuf[rp + 1];
+                    v2  = lbuf[rp + 2];
+                }
+                else
+                {
+                    /* at buffer wrap-around, need to check index */
+                    if(--rp < 0)
+                        rp += size_n;
+                    vm1 = lbuf[rp];
+                    if(++rp >= size_n)
+                        rp -= size_n;
+                    v0 = lbuf[rp];
+                    if(++rp >= size_n)
+                        rp -= size_n;
+                    v1 = lbuf[rp];
+                    if(++rp >= size_n)
+                        rp -= size_n;
+                    v2 = lbuf[rp];
+                }
+
+                /* Process works these out in double, but with float operands
+                   and constants exact in float, one double op rounded back to
+                   float is the float op - all but the 1/6, which stays double */
+                float frac = (float)rf * (1.0f / (float)DELAYPOS_SCALE);
+                float a2   = frac * frac;
+                a2 -= 1.0f;
+                a2 = (float)(a2 * (1.0 / 6.0));
+                float a1 = frac;
+                a1 += 1.0f;
+                a1 *= 0.5f;
+                float am1 = a1 - 1.0f;
+                float a0  = 3.0f * a2;
+                a1 -= a0;
+                am1 -= a2;
+                a0 -= frac;
+                float v = (am1 * vm1 + a0 * v0 + a1 * v1 + a2 * v2) * frac + v0;
+                read_pos_frac[n] = rf + read_pos_frac_inc[n];
+                v *= feedback;
+                v               = (filter_state[n] - v) * damp_fact + v;
+                filter_state[n] = v;
+            }
+
+            /* mix to output, in line order as in Process */
+            float a_out_l = 0.0, a_out_r = 0.0;
+            for(int n = 0; n < 8; n += 2)
+            {
+                a_out_l += filter_state[n];
+                a_out_r += filter_state[n + 1];
+            }
+            out1[i] = a_out_l * kOutputGain;
+            out2[i] = a_out_r * kOutputGain;
+        }
+
+        /* start next random line segment if current one has reached endpoint */
+        for(int n = 0; n < 8; n++)
+        {
+            rand_line_cnt[n] -= run;
+            if(rand_line_cnt[n] > 0)
+                continue;
+            ReverbScDl *lp    = &delay_lines_[n];
+            lp->write_pos     = write_pos[n];
+            lp->read_pos      = read_pos[n];
+            lp->read_pos_frac = read_pos_frac[n];
+            NextRandomLineseg(lp, n);
+            rand_line_cnt[n]     = lp->rand_line_cnt;
+            read_pos_frac_inc[n] = lp->read_pos_frac_inc;
+        }
+    }
+
+    for(int n = 0; n < 8; n++)
+    {
+        delay_lines_[n].write_pos         = write_pos[n];
+        delay_lines_[n].read_pos          = read_pos[n];
+        delay_lines_[n].read_pos_frac     = read_pos_frac[n];
+        delay_lines_[n].read_pos_frac_inc = read_pos_frac_inc[n];
+        delay_lines_[n].rand_line_cnt     = rand_line_cnt[n];
+        delay_lines_[n].filter_state      = filter_state[n];
+    }
+    return REVSC_OK;
+}
+
+void ReverbSc::ProcessMixBlock(float *left, float *right, size_t size){
+  /* the wet signal goes through a small buffer, as the dry input is still
+    needed after it is made */
+  float wet_l[32], wet_r[32];
+  while (size > 0){
+    size_t n = size < 32 ? size : 32;
+    ProcessBlock(left, right, wet_l, wet_r, n);
+    for (size_t i=0; i<n; i++){
+      left[i] = wet_mix_*wet_l[i] + ((1.0f-wet_mix_)*left[i]);
+      right[i] = wet_mix_*wet_r[i] + ((1.0f-wet_mix_)*right[i]);
+    }
+    left += n;
+    right += n;
+    size -= n;
+  }
+}
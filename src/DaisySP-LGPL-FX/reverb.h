@@ -10,6 +10,8 @@ https://opensource.org/license/lgpl-2-1/
 #ifndef DSYSP_REVERBSC_H
 #define DSYSP_REVERBSC_H
 
+#include <stddef.h>
+
 #define DSY_REVERBSC_MAX_SIZE 98936
 
 namespace daisysp
@@ -47,6 +49,22 @@ class ReverbSc
 
     void ProcessMix(const float &in1, const float &in2, float *out1, float *out2);
 
+    /** Processes a block, giving the same output as calling Process for each
+        frame in turn. The 8 delay lines are worked on as lanes - their state
+        is copied into arrays for the block, the tone filter is checked once
+        per block rather than per sample, and the random delay segments once
+        per run of frames up to the next segment. Blocks under 8 frames go
+        through Process.
+        \param in1, in2 - input buffers
+        \param out1, out2 - output buffers, may be the same as the inputs
+        \param size - number of frames
+    */
+    int ProcessBlock(const float *in1, const float *in2, float *out1, float *out2, size_t size);
+
+    /** ProcessMix for a block, in place, giving the same output as ProcessMix
+        for each frame in turn */
+    void ProcessMixBlock(float *left, float *right, size_t size);
+
     /** controls the reverb time. reverb tail becomes infinite when set to 1.0
         \param fb - sets reverb time. range: 0.0 to 1.0
     */
@@ -60,6 +78,7 @@ class ReverbSc
 
   private:
     void       NextRandomLineseg(ReverbScDl *lp, int n);
+    void       UpdateDampFact();
     int        InitDelayLine(ReverbScDl *lp, int n);
     float      feedback_, lpfreq_;
     float      i_sample_rate_, i_pitch_mod_, i_skip_init_;
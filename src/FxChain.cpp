@@ -0,0 +1,107 @@
+#include "FxChain.h"
+#include "StageProfiler.h"
+
+using namespace daisysp;
+
+/// @brief Initialise the reverb, filters and limiter, with the reverb dry
+///        and both filters open
+/// @param sample_rate Audio sample rate in Hz
+void FxChain::Init(float sample_rate){
+  limiter_.Init();
+  reverb_.Init(sample_rate);
+  reverb_.SetMix(0.0f);
+  reverb_.SetFeedback(0.0f);
+  lowpass_moog_.Init(sample_rate);
+  lowpass_moog_.SetFreq(LOPASS_UPPER_BOUND);
+  lowpass_moog_.SetRes(0.7f);
+
+  hipass_.Init();
+  hipass_.SetFilterMode(daisysp::OnePole::FilterMode::FILTER_MODE_HIGH_PASS);
+  hipass_.SetFrequency(HIPASS_LOWER_BOUND);
+
+  hicut_.Init();
+  hicut_.SetFilterMode(daisysp::OnePole::FilterMode::FILTER_MODE_LOW_PASS);
+  hicut_.SetFrequency(HICUT_FREQ);
+
+  /* filter sweeps glide with a 30ms time constant, settling within 1Hz for the
+    moog and a hundredth of the high pass range. Reverb changes ramp over 50ms */
+  lowpass_freq_.Init(sample_rate, 0.03f, LOPASS_UPPER_BOUND, 1.0f);
+  hipass_freq_.Init(sample_rate, 0.03f, HIPASS_LOWER_BOUND, (HIPASS_UPPER_BOUND - HIPASS_LOWER_BOUND) * 0.01f);
+  reverb_feedback_.Init(sample_rate, 0.05f, 0.0f);
+  reverb_mix_.Init(sample_rate, 0.05f, 0.0f);
+}
+
+/// @brief Sets new targets for the FX controls that differ from the last parameters
+/// @param p Latest parameters
+/// @param prev Parameters applied before p
+void FxChain::SetParams(const SynthParams &p, const SynthParams &prev){
+  /* reverb feedback sets the tail length */
+  if (p.reverb_feedback != prev.reverb_feedback) reverb_feedback_.SetTarget(p.reverb_feedback);
+  if (p.reverb_mix != prev.reverb_mix) reverb_mix_.SetTarget(p.reverb_mix);
+  if (p.lowpass != prev.lowpass){
+    /* cutoff of the low pass moog filter, on an exponential curve */
+    lowpass_freq_.SetTarget(fmap(p.lowpass, LOPASS_LOWER_BOUND, LOPASS_UPPER_BOUND, daisysp::Mapping::EXP));
+  }
+  if (p.hipass != prev.hipass){
+    /* cutoff of the high pass filter, on an exponential curve */
+    hipass_freq_.SetTarget(fmap(p.hipass, HIPASS_LOWER_BOUND, HIPASS_UPPER_BOUND, daisysp::Mapping::EXP));
+  }
+}
+
+/// @brief Moves the smoothed FX controls on by one block and passes on the ones
+///        still moving. The filters recompute their coefficients when their
+///        frequency changes, so this caps that to once per block and stops once
+///        the knob has settled
+/// @param size Number of samples in the block
+void FxChain::Update(size_t size){
+  if (lowpass_freq_.Process(size)) lowpass_moog_.SetFreq(lowpass_freq_.Value());
+  if (hipass_freq_.Process(size)) hipass_.SetFrequency(hipass_freq_.Value());
+  if (reverb_feedback_.Process(size)) reverb_.SetFeedback(reverb_feedback_.Value());
+  if (reverb_mix_.Process(size)) reverb_.SetMix(reverb_mix_.Value());
+}
+
+/// @brief Runs a block of synth output through the chain in place, limiting
+///        each sample a second time on the way out. Each effect runs over the
+///        whole block before the next, which gives the same output as running
+///        the chain sample by sample - every effect keeps its own state - and
+///        lets the stage profiler time them one by one
+/// @param left Left channel buffer
+/// @param right Right channel buffer
+/// @param size Number of samples to process in this call
+void FxChain::ProcessBlock(float *left, float *right, size_t size){
+  {
+    PROFILE_STAGE(Hipass);
+    for (size_t i=0; i<size; i++){
+      left[i] = hipass_.Process(left[i]);
+      right[i] = hipass_.Process(right[i]);
+    }
+  }
+  {
+    PROFILE_STAGE(Moog);
+    for (size_t i=0; i<size; i++){
+      left[i] = lowpass_moog_.Process(left[i]);
+      right[i] = lowpass_moog_.Process(right[i]);
+    }
+  }
+  {
+    PROFILE_STAGE(Reverb);
+    reverb_.ProcessMixBlock(left, right, size);
+  }
+  {
+    PROFILE_STAGE(Hicut);
+    for (size_t i=0; i<size; i++){
+      left[i] = hicut_.Process(left[i]);
+      right[i] = hicut_.Process(right[i]);
+    }
+  }
+  {
+    PROFILE_STAGE(Limiter);
+    for (size_t i=0; i<size; i++){
+      /* limited once as in Process, then again on the way out */
+      limiter_.ProcessBlock(&left[i], 1, 0.5f);
+      limiter_.ProcessBlock(&right[i], 1, 0.5f);
+      limiter_.ProcessBlock(&left[i], 1, 0.5f);
+      limiter_.ProcessBlock(&right[i], 1, 0.5f);
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "daisysp.h"
+#include "DaisySP-LGPL-FX/moogladder.h"
+#include "SynthParams.h"
+#include "ParamSmoother.h"
+
+/* The effects the synth output runs through: high pass, moog low pass,
+  reverb, a fixed high cut to take the edge off the top end and a limiter.
+  Shared by the app and the offline renderer so both sound the same.
+  The reverb is passed in as it is too big for internal RAM - on the Pod it
+  lives in SDRAM */
+class FxChain {
+  public:
+    FxChain(daisysp::ReverbSc &reverb) : reverb_(reverb) {}
+
+    void Init(float sample_rate);
+    void SetParams(const SynthParams &p, const SynthParams &prev);
+    void Update(size_t size);
+    void ProcessBlock(float *left, float *right, size_t size);
+
+  private:
+    daisysp::Limiter limiter_;
+    daisysp::ReverbSc &reverb_;
+    daisysp::MoogLadder lowpass_moog_;
+    daisysp::OnePole hipass_;
+    /* filter to reduce high end noise */
+    daisysp::OnePole hicut_;
+    /* controls, smoothed and applied once per block by Update */
+    OnePoleSmoother lowpass_freq_;
+    OnePoleSmoother hipass_freq_;
+    LinearRamp reverb_feedback_;
+    LinearRamp reverb_mix_;
+};
@@ -0,0 +1,178 @@
+#include "GrainCache.h"
+
+#ifdef STM32H750xx
+/* the whole slab is copied as one MDMA block */
+static_assert(GrainCache::kSlabFrames * 2 * sizeof(int16_t) <= 65536,
+              "grain cache slabs must fit in one MDMA block");
+#endif
+
+/// @brief Sets up the copy engine and frees all slabs
+void GrainCache::Init(){
+#ifdef STM32H750xx
+  if (copying_ != kNoSlab){
+    HAL_MDMA_Abort(&mdma_);
+  }
+  __HAL_RCC_MDMA_CLK_ENABLE();
+  mdma_.Instance = MDMA_Channel0;
+  mdma_.Init.Request = MDMA_REQUEST_SW;
+  mdma_.Init.TransferTriggerMode = MDMA_BLOCK_TRANSFER;
+  mdma_.Init.Priority = MDMA_PRIORITY_LOW;
+  mdma_.Init.Endianness = MDMA_LITTLE_ENDIANNESS_PRESERVE;
+  /* halfword transfers so mono regions starting on an odd frame are aligned */
+  mdma_.Init.SourceInc = MDMA_SRC_INC_HALFWORD;
+  mdma_.Init.DestinationInc = MDMA_DEST_INC_HALFWORD;
+  mdma_.Init.SourceDataSize = MDMA_SRC_DATASIZE_HALFWORD;
+  mdma_.Init.DestDataSize = MDMA_DEST_DATASIZE_HALFWORD;
+  mdma_.Init.DataAlignment = MDMA_DATAALIGN_PACKENABLE;
+  mdma_.Init.BufferTransferLength = 128;
+  mdma_.Init.SourceBurst = MDMA_SOURCE_BURST_SINGLE;
+  mdma_.Init.DestBurst = MDMA_DEST_BURST_SINGLE;
+  mdma_.Init.SourceBlockAddressOffset = 0;
+  mdma_.Init.DestBlockAddressOffset = 0;
+  HAL_MDMA_Init(&mdma_);
+#endif
+  copying_ = kNoSlab;
+  for (size_t i=0; i<kNumSlabs; i++){
+    slabs_[i].Init(mem_[i], kSlabFrames * 2);
+    slab_src_[i] = nullptr;
+  }
+  Reset();
+  ResetStats();
+}
+
+/// @brief Frees every slab. Any copy still running is left to finish and discarded
+void GrainCache::Reset(){
+  for (size_t i=0; i<kNumSlabs; i++){
+    state_[i] = SlabState::Free;
+    orphaned_[i] = false;
+  }
+  if (copying_ != kNoSlab){
+    state_[copying_] = SlabState::Copying;
+    orphaned_[copying_] = true;
+  }
+  queue_len_ = 0;
+}
+
+/// @brief Takes a free slab for a grain and starts copying its source region in
+/// @param src Store the grain reads from
+/// @param first First frame the grain reads, including interpolation points
+/// @param frames Number of frames the grain reads
+/// @param audio_len Length of the audio in src, regions can't wrap past it
+/// @return Slab index, or kNoSlab if the grain should read from SDRAM
+uint8_t GrainCache::Stage(const SampleStore *src, size_t first, size_t frames, size_t audio_len){
+  if (frames > kSlabFrames || first + frames > audio_len){
+    stats_.misses_size++;
+    return kNoSlab;
+  }
+  uint8_t slab = kNoSlab;
+  for (size_t i=0; i<kNumSlabs; i++){
+    if (state_[i] == SlabState::Free){
+      slab = static_cast<uint8_t>(i);
+      break;
+    }
+  }
+  if (slab == kNoSlab){
+    stats_.misses_full++;
+    return kNoSlab;
+  }
+  stats_.hits++;
+  slab_src_[slab] = src;
+  slabs_[slab].SetChannels(src->Channels());
+  slabs_[slab].SetFirstFrame(first);
+  slabs_[slab].SetLength(frames);
+  if (copying_ == kNoSlab){
+    StartCopy(slab);
+  }
+  else {
+    state_[slab] = SlabState::Queued;
+    queue_[queue_len_++] = slab;
+  }
+  return slab;
+}
+
+/// @brief Gives a slab back once its grain has finished
+void GrainCache::Release(uint8_t slab){
+  switch (state_[slab]){
+    case SlabState::Queued:
+      for (size_t i=0; i<queue_len_; i++){
+        if (queue_[i] != slab) continue;
+        for (size_t j=i+1; j<queue_len_; j++) queue_[j-1] = queue_[j];
+        queue_len_--;
+        break;
+      }
+      state_[slab] = SlabState::Free;
+      break;
+    case SlabState::Copying:
+      orphaned_[slab] = true;
+      break;
+    default:
+      state_[slab] = SlabState::Free;
+      break;
+  }
+}
+
+/// @brief Checks for a finished copy and starts the next queued one. Call once per block
+void GrainCache::Service(){
+  if (copying_ != kNoSlab){
+    bool ok;
+    if (!CopyDone(ok)) return;
+    uint8_t slab = copying_;
+    copying_ = kNoSlab;
+    if (orphaned_[slab]){
+      orphaned_[slab] = false;
+      state_[slab] = SlabState::Free;
+    }
+    else {
+      state_[slab] = ok ? SlabState::Ready : SlabState::Failed;
+    }
+  }
+  /* a copy that fails to start leaves the engine idle, so keep going */
+  while (copying_ == kNoSlab && queue_len_ > 0){
+    uint8_t slab = queue_[0];
+    for (size_t i=1; i<queue_len_; i++) queue_[i-1] = queue_[i];
+    queue_len_--;
+    StartCopy(slab);
+  }
+}
+
+/// @brief Starts copying a slab's region out of the sample store
+void GrainCache::StartCopy(uint8_t slab){
+  const size_t channels = slab_src_[slab]->Channels();
+  const int16_t *src = slab_src_[slab]->Data() + slabs_[slab].FirstFrame() * channels;
+  const size_t bytes = slabs_[slab].Length() * channels * sizeof(int16_t);
+#ifdef STM32H750xx
+  /* SDRAM is cached, so write back anything the CPU recorded into the
+    region first. Cache maintenance works on whole 32 byte lines */
+  uint32_t addr = reinterpret_cast<uint32_t>(src);
+  uint32_t aligned = addr & ~31u;
+  SCB_CleanDCache_by_Addr(reinterpret_cast<uint32_t*>(aligned), bytes + (addr - aligned));
+  if (HAL_MDMA_Start(&mdma_, addr, reinterpret_cast<uint32_t>(mem_[slab]), bytes, 1) != HAL_OK){
+    state_[slab] = SlabState::Failed;
+    return;
+  }
+  state_[slab] = SlabState::Copying;
+  copying_ = slab;
+#else
+  memcpy(mem_[slab], src, bytes);
+  state_[slab] = SlabState::Ready;
+#endif
+}
+
+/// @brief Polls the copy engine without blocking
+/// @param ok Set to false if the copy failed
+/// @return True once the running copy has finished
+bool GrainCache::CopyDone(bool &ok){
+#ifdef STM32H750xx
+  if (__HAL_MDMA_GET_FLAG(&mdma_, MDMA_FLAG_CTC | MDMA_FLAG_TE) == 0U) return false;
+  /* the flag is already set, so this only clears it and updates the handle */
+  ok = HAL_MDMA_PollForTransfer(&mdma_, HAL_MDMA_FULL_TRANSFER, 0) == HAL_OK;
+  if (ok){
+    /* drop any stale lines so the CPU sees what the MDMA wrote */
+    SCB_InvalidateDCache_by_Addr(reinterpret_cast<uint32_t*>(mem_[copying_]), sizeof(mem_[copying_]));
+  }
+  return true;
+#else
+  ok = true;
+  return true;
+#endif
+}
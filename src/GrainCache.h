@@ -0,0 +1,94 @@
+#pragma once
+#include "SampleStore.h"
+
+#ifdef STM32H750xx
+#include "stm32h7xx_hal.h"
+#endif
+
+/* number and size of the staging slabs - eg -DGRAIN_CACHE_SLABS=8 for dense
+  clouds of short grains. Grains reading more than GRAIN_CACHE_SLAB_FRAMES
+  frames always read straight from SDRAM */
+#ifndef GRAIN_CACHE_SLABS
+#define GRAIN_CACHE_SLABS 4
+#endif
+#ifndef GRAIN_CACHE_SLAB_FRAMES
+#define GRAIN_CACHE_SLAB_FRAMES 10240
+#endif
+
+/* Slab memory, aligned to the M7 cache line for cache maintenance - 160KB at
+  the defaults. That's too much for the app's .bss in AXI SRAM, so like the
+  reverb's delay lines it's placed by main.cpp and passed in: on the Pod it
+  goes in the 256KB of D2 SRAM the app doesn't otherwise use (GRAIN_SLAB_BSS),
+  which the MDMA can reach and the CPU reads through its data cache */
+struct GrainSlabMemory {
+  alignas(32) int16_t slab[GRAIN_CACHE_SLABS][GRAIN_CACHE_SLAB_FRAMES * 2];
+};
+#ifdef STM32H750xx
+#define GRAIN_SLAB_BSS __attribute__((section(".d2_bss")))
+#else
+#define GRAIN_SLAB_BSS
+#endif
+
+/* Staging cache for grain source audio. When a grain is triggered the region
+  of the sample store it will read is copied into a slab of internal SRAM,
+  and the grain renders from the slab instead of making random SDRAM reads.
+  Slabs can be staged from any sample store, eg a mip-map level.
+  On the Pod the copy is done by MDMA in the background and the grain reads
+  from SDRAM until its slab is ready; host builds copy with memcpy straight
+  away. Grains that don't fit, or arrive when every slab is taken, read from
+  SDRAM as before - the counters show how often that happens */
+class GrainCache {
+  public:
+    static constexpr size_t kNumSlabs = GRAIN_CACHE_SLABS;
+    static constexpr size_t kSlabFrames = GRAIN_CACHE_SLAB_FRAMES;
+    static constexpr uint8_t kNoSlab = 0xFF;
+
+    struct Stats {
+      size_t hits;          /* grains given a slab */
+      size_t misses_full;   /* grains that fit but found every slab taken */
+      size_t misses_size;   /* grains too long for a slab, or wrapping round the audio */
+    };
+
+    GrainCache(GrainSlabMemory &mem) : queue_len_(0), copying_(kNoSlab), mem_(mem.slab) {}
+
+    void Init();
+    void Reset();
+    uint8_t Stage(const SampleStore *src, size_t first, size_t frames, size_t audio_len);
+    void Release(uint8_t slab);
+    void Service();
+
+    bool Ready(uint8_t slab) const { return state_[slab] == SlabState::Ready; }
+    const SampleStore* Slab(uint8_t slab) const { return &slabs_[slab]; }
+    const Stats& GetStats() const { return stats_; }
+    void ResetStats() { stats_ = {0, 0, 0}; }
+
+  private:
+    enum class SlabState : uint8_t {
+      Free,
+      Queued,   /* waiting for the copy engine */
+      Copying,
+      Ready,
+      Failed    /* copy failed - held until released, the grain reads from SDRAM */
+    };
+
+    void StartCopy(uint8_t slab);
+    bool CopyDone(bool &ok);
+
+    SampleStore slabs_[kNumSlabs];
+    /* store each slab is copied from */
+    const SampleStore *slab_src_[kNumSlabs];
+    SlabState state_[kNumSlabs];
+    /* released while its copy was running - freed once the copy finishes */
+    bool orphaned_[kNumSlabs];
+    /* slabs waiting for the copy engine, oldest first */
+    uint8_t queue_[kNumSlabs];
+    size_t queue_len_;
+    uint8_t copying_;
+    Stats stats_;
+
+#ifdef STM32H750xx
+    MDMA_HandleTypeDef mdma_;
+#endif
+    /* slab memory, see GrainSlabMemory */
+    int16_t (*mem_)[kSlabFrames * 2];
+};
@@ -0,0 +1,21 @@
+#include "GrainPan.h"
+
+/// @brief Builds the pan table. Uses the precise libm functions as this
+///        only runs at startup, not per sample
+void GrainPans::Init(){
+  /* sin/cos law, scaled so a centred grain plays at unity gain on both
+    channels as it did before grains could be panned */
+  const float size = static_cast<float>(kTableSize);
+  for (size_t i=0; i<=kTableSize; i++){
+    float pan = static_cast<float>(i) / size;
+    left_[i] = cosf(0.5f * M_PI * pan) * M_SQRT2;
+    right_[i] = sinf(0.5f * M_PI * pan) * M_SQRT2;
+  }
+  /* pin the ends and centre that float rounding misses, so centred grains
+    are bit-exact with unpanned ones */
+  left_[kTableSize] = 0.0f;
+  left_[kTableSize/2] = right_[kTableSize/2] = 1.0f;
+  /* guard points for interpolating at pan 1.0 */
+  left_[kTableSize+1] = left_[kTableSize];
+  right_[kTableSize+1] = right_[kTableSize];
+}
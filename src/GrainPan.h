@@ -0,0 +1,34 @@
+#pragma once
+#include <algorithm>
+#include "constants_utils.h"
+
+/* Precomputed constant-power pan law. A grain looks up its left and right
+  gains once when it is triggered and keeps them as part of its state, so
+  spreading the cloud across the stereo field costs two multiplies per
+  sample instead of any trig */
+class GrainPans {
+  public:
+    static constexpr size_t kTableSize = 256;
+
+    GrainPans(){}
+
+    void Init();
+
+    /// @brief Interpolated pan gains for a position
+    /// @param pan Pan position, 0 is hard left, 0.5 centre and 1 hard right
+    /// @param left Left channel gain output
+    /// @param right Right channel gain output
+    inline void Lookup(float pan, float &left, float &right) const {
+      float pos = std::min(std::max(pan, 0.0f), 1.0f) * static_cast<float>(kTableSize);
+      size_t idx = static_cast<size_t>(pos);
+      float frac = pos - static_cast<float>(idx);
+      left = left_[idx] + frac * (left_[idx+1] - left_[idx]);
+      right = right_[idx] + frac * (right_[idx+1] - right_[idx]);
+    }
+
+  private:
+    /* channel gains from hard left to hard right - kTableSize+2 points,
+      so pan 1.0 and its interpolation neighbour are both in range */
+    float left_[kTableSize+2];
+    float right_[kTableSize+2];
+};
@@ -0,0 +1,503 @@
+#include "GrainPool.h"
+#include <algorithm>
+
+#ifdef GRAIN_USE_CMSIS
+#include "arm_math.h"
+#endif
+
+using namespace grainsimd;
+
+/* 32.32 fixed point helpers for grain read positions */
+static constexpr float kFixedScale = 4294967296.0f;
+static constexpr float kFixedScaleInv = 1.0f / 4294967296.0f;
+static inline uint64_t ToFixed(size_t whole) { return static_cast<uint64_t>(whole) << 32; }
+static inline uint64_t ToFixed(float x) { return static_cast<uint64_t>(x * kFixedScale); }
+
+/* 4-point 3rd-order Hermite, see 
+  http://yehar.com/blog/wp-content/uploads/2009/08/deip.pdf (section 6.2.4) */
+static inline float Hermite(float xm1, float x0, float x1, float x2, float f){
+  float c1 = 0.5f * (x1 - xm1);
+  float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+  float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+  return ((c3 * f + c2) * f + c1) * f + x0;
+}
+
+/// @brief Assigns the sample store grains read from and deactivates all grains
+/// @param store Store holding the loaded or recorded audio
+/// @param audio_len Length in frames of the audio in the store
+/// @param mips Decimated copies of the audio for pitched up grains, or nullptr
+///        to always read the store
+void GrainPoolImpl::Init(const SampleStore *store, size_t audio_len, const SampleMipMap *mips){
+  store_ = store;
+  audio_len_ = audio_len;
+  level_src_[0] = store;
+  level_len_[0] = audio_len;
+  level_wrap_[0] = ToFixed(audio_len);
+  num_levels_ = 1;
+  /* only use levels built from this audio */
+  while (mips && num_levels_ < mips->Levels()){
+    size_t len = audio_len >> num_levels_;
+    const SampleStore *level = mips->Level(num_levels_);
+    if (len == 0 || level->Length() < len) break;
+    level_src_[num_levels_] = level;
+    level_len_[num_levels_] = len;
+    level_wrap_[num_levels_] = ToFixed(len);
+    num_levels_++;
+  }
+  windows_.Init();
+  taper_pending_ = false;
+  pans_.Init();
+  cache_.Init();
+  Reset();
+}
+
+/// @brief Deactivates all grains and clears their state
+void GrainPoolImpl::Reset(){
+  for (size_t i=0; i<capacity_; i++){
+    read_pos_[i] = 0;
+    read_inc_[i] = 0;
+    env_pos_[i] = 0.0f;
+    env_inc_[i] = 0.0f;
+    fade_[i] = 1.0f;
+    fade_inc_[i] = 0.0f;
+    pan_left_[i] = 1.0f;
+    pan_right_[i] = 1.0f;
+    window_[i] = windows_.GetTable(WindowShape::Hann);
+    src_[i] = store_;
+    slab_[i] = GrainCache::kNoSlab;
+    level_[i] = 0;
+    owner_[i] = 0;
+    active_[i] = 0;
+  }
+  for (size_t i=0; i<kMaxOwners; i++){
+    owner_count_[i] = 0;
+    owner_limit_[i] = max_grains_;
+  }
+  cache_.Reset();
+  active_count_ = 0;
+  releasing_count_ = 0;
+  steal_count_ = 0;
+}
+
+/// @brief Starts a grain playing in the first free slot and assigns its parameters.
+///        If the pool or the owner's limit is full, a grain is stolen to make room
+///        according to the steal policy
+/// @param pos Spawn position of the grain, within the audio buffer
+/// @param grain_size Length of audio the grain reads, in samples
+/// @param pitch_ratio Pitch of the grain - 1 plays the grain at its regular pitch
+/// @param shape Envelope shape the grain is played with
+/// @param owner Group the grain is counted under, see OwnerCount
+/// @param pan Stereo position of the grain, 0 is hard left, 0.5 centre and 1 hard right
+/// @param gain Level the grain plays at, on top of its envelope
+/// @return False if the grain was not started
+bool GrainPoolImpl::Trigger(size_t pos, size_t grain_size, float pitch_ratio, WindowShape shape,
+                            uint8_t owner, float pan, float gain){
+  bool over_limit = owner_count_[owner] >= owner_limit_[owner];
+  if (over_limit || Full()){
+    if (steal_policy_ == StealPolicy::None) return false;
+    size_t victim = FindVictim(over_limit, owner);
+    if (victim >= active_count_) return false;
+    StartFade(victim, kStealFadeSamples);
+    steal_count_++;
+  }
+  size_t slot;
+  if (active_count_ < capacity_){
+    slot = active_count_++;
+  }
+  else {
+    /* every spare slot is still fading out a stolen grain, so cut the
+      quietest of those short rather than drop the new grain */
+    slot = MostFaded();
+    releasing_count_--;
+    ReleaseSlab(slot);
+  }
+  if (pos >= audio_len_) pos -= audio_len_;
+  /* each level halves the bandwidth and the frame rate, so read from level
+    ceil(log2(pitch)) - the step through the level stays at or under one
+    frame per sample, so nothing the grain reads folds back. Only grains at
+    or below 1x read the full band of level 0 */
+  size_t level = 0;
+  while (level + 1 < num_levels_ && pitch_ratio > static_cast<float>(1u << level)){
+    level++;
+  }
+  const size_t level_pos = pos >> level;
+  /* stage from one frame before pos for the interpolation, with room for
+    the envelope running a little past grain_size and the points after it */
+  slab_[slot] = level_pos > 0
+              ? cache_.Stage(level_src_[level], level_pos - 1, (grain_size >> level) + kStageGuard,
+                             level_len_[level])
+              : GrainCache::kNoSlab;
+  src_[slot] = level_src_[level];
+  level_[slot] = static_cast<uint8_t>(level);
+  /* the grain reads grain_size samples at pitch_ratio speed, so it
+    lasts grain_size/pitch_ratio output samples */
+  env_pos_[slot] = 0.0f;
+  env_inc_[slot] = pitch_ratio/static_cast<float>(grain_size);
+  fade_[slot] = 1.0f;
+  fade_inc_[slot] = 0.0f;
+  pans_.Lookup(pan, pan_left_[slot], pan_right_[slot]);
+  pan_left_[slot] *= gain;
+  pan_right_[slot] *= gain;
+  read_pos_[slot] = ToFixed(pos) >> level;
+  read_inc_[slot] = ToFixed(pitch_ratio) >> level;
+  window_[slot] = windows_.GetTable(shape);
+  owner_[slot] = owner;
+  owner_count_[owner]++;
+  active_[slot] = ~0u;
+  return true;
+}
+
+/// @brief Picks the grain to steal according to the steal policy. Grains already
+///        fading out are never picked
+/// @param same_owner Only consider grains of owner
+/// @param owner Owner to pick from when same_owner is set
+/// @return Slot of the grain to steal, or active_count_ if there is none
+size_t GrainPoolImpl::FindVictim(bool same_owner, uint8_t owner) const {
+  size_t victim = active_count_;
+  float best = 0.0f;
+  for (size_t slot=0; slot<active_count_; slot++){
+    if (fade_inc_[slot] < 0.0f) continue;
+    if (same_owner && owner_[slot] != owner) continue;
+    float score;
+    switch (steal_policy_){
+      case StealPolicy::Oldest:
+        /* samples played so far */
+        score = -env_pos_[slot] / env_inc_[slot];
+        break;
+      case StealPolicy::NearestFinish:
+        /* samples left to play */
+        score = (1.0f - env_pos_[slot]) / env_inc_[slot];
+        break;
+      case StealPolicy::Quietest:
+      default:
+        /* envelope level, but grains still in their first half count as
+          full level so a grain that has only just started isn't stolen */
+        score = env_pos_[slot] < 0.5f ? 1.0f
+              : GrainWindows::Lookup(window_[slot], std::min(env_pos_[slot], 1.0f));
+        break;
+    }
+    if (victim == active_count_ || score < best){
+      victim = slot;
+      best = score;
+    }
+  }
+  return victim;
+}
+
+/// @brief Finds the stolen grain closest to the end of its fade out
+size_t GrainPoolImpl::MostFaded() const {
+  size_t slot = 0;
+  float lowest = 2.0f;
+  for (size_t i=0; i<active_count_; i++){
+    if (fade_inc_[i] < 0.0f && fade_[i] < lowest){
+      slot = i;
+      lowest = fade_[i];
+    }
+  }
+  return slot;
+}
+
+/// @brief Starts a grain's fade out and stops counting it against its owner
+/// @param fade_samples Length of the fade out
+void GrainPoolImpl::StartFade(size_t slot, float fade_samples){
+  fade_inc_[slot] = -fade_[slot] / fade_samples;
+  owner_count_[owner_[slot]]--;
+  releasing_count_++;
+}
+
+/// @brief Fades out every playing grain of an owner, eg when a note is released.
+///        The owner's count drops to 0 straight away, the grains finish in the
+///        background like stolen ones
+/// @param owner Group of grains to fade out
+/// @param fade_samples Length of the fade out, at least 1
+void GrainPoolImpl::ReleaseOwner(uint8_t owner, float fade_samples){
+  fade_samples = std::max(fade_samples, 1.0f);
+  for (size_t slot=0; slot<active_count_; slot++){
+    if (owner_[slot] == owner && fade_inc_[slot] >= 0.0f){
+      StartFade(slot, fade_samples);
+    }
+  }
+}
+
+/// @brief Fades out an owner's grains until it is back within its limit, eg after
+///        the limit has been lowered. Grains are picked as for stealing
+void GrainPoolImpl::Shed(uint8_t owner){
+  while (owner_count_[owner] > owner_limit_[owner]){
+    size_t victim = FindVictim(true, owner);
+    if (victim >= active_count_) return;
+    StartFade(victim, kStealFadeSamples);
+  }
+}
+
+/// @brief Copies a grain's state to another slot, used to keep playing grains packed
+void GrainPoolImpl::MoveSlot(size_t from, size_t to){
+  read_pos_[to] = read_pos_[from];
+  read_inc_[to] = read_inc_[from];
+  env_pos_[to] = env_pos_[from];
+  env_inc_[to] = env_inc_[from];
+  fade_[to] = fade_[from];
+  fade_inc_[to] = fade_inc_[from];
+  pan_left_[to] = pan_left_[from];
+  pan_right_[to] = pan_right_[from];
+  window_[to] = window_[from];
+  src_[to] = src_[from];
+  slab_[to] = slab_[from];
+  level_[to] = level_[from];
+  owner_[to] = owner_[from];
+  active_[to] = active_[from];
+  active_[from] = 0;
+}
+
+/// @brief Switches grains over to their staged slab once its copy has finished
+void GrainPoolImpl::UpdateSources(){
+  cache_.Service();
+  for (size_t slot=0; slot<active_count_; slot++){
+    uint8_t slab = slab_[slot];
+    if (slab != GrainCache::kNoSlab && src_[slot] != cache_.Slab(slab) && cache_.Ready(slab)){
+      src_[slot] = cache_.Slab(slab);
+    }
+  }
+}
+
+/// @brief Gives a grain's staged slab, if it has one, back to the cache
+void GrainPoolImpl::ReleaseSlab(size_t slot){
+  if (slab_[slot] == GrainCache::kNoSlab) return;
+  cache_.Release(slab_[slot]);
+  slab_[slot] = GrainCache::kNoSlab;
+  src_[slot] = level_src_[level_[slot]];
+}
+
+/// @brief Returns grains that finished during the last block to the free list by
+///        swapping the last playing grain into each freed slot
+void GrainPoolImpl::ReleaseFinished(){
+  size_t slot = 0;
+  while (slot < active_count_){
+    if (active_[slot]){
+      slot++;
+      continue;
+    }
+    ReleaseSlab(slot);
+    if (fade_inc_[slot] < 0.0f){
+      releasing_count_--;
+    }
+    else {
+      owner_count_[owner_[slot]]--;
+    }
+    active_count_--;
+    if (slot != active_count_){
+      MoveSlot(active_count_, slot);
+    }
+  }
+}
+
+/// @brief Sets the taper of Tukey grains triggered from now on. Call from the
+///        audio callback, as it may rebuild a window table. If every spare
+///        table is held by grains still playing, the change waits for them
+/// @param taper Fraction of the grain spent tapering (0 = rectangle, 1 = Hann)
+void GrainPoolImpl::SetTukeyTaper(float taper){
+  pending_taper_ = taper;
+  taper_pending_ = !windows_.SetTukeyTaper(taper, TukeyTablesInUse());
+}
+
+/// @brief Which Tukey tables playing grains read, including stolen grains
+///        still fading out
+/// @return Bit i set for Tukey table i
+uint32_t GrainPoolImpl::TukeyTablesInUse() const{
+  uint32_t in_use = 0;
+  for (size_t slot=0; slot<active_count_; slot++){
+    size_t table = windows_.TukeyIndex(window_[slot]);
+    if (table < GrainWindows::kTukeyTables) in_use |= 1u << table;
+  }
+  return in_use;
+}
+
+/// @brief Renders all active grains for a block of audio, summing into the output buffers
+/// @param out_left Left channel output buffer, accumulated into
+/// @param out_right Right channel output buffer, accumulated into
+/// @param size Number of samples to render in this call
+void GrainPoolImpl::ProcessBlock(float *out_left, float *out_right, size_t size){
+  if (taper_pending_) SetTukeyTaper(pending_taper_);
+  UpdateSources();
+#ifdef GRAIN_USE_CMSIS
+  /* no float SIMD on the M7: render one grain at a time into scratch and
+    let CMSIS-DSP do the unrolled envelope multiply and mix */
+  for (size_t slot=0; slot<active_count_; slot++){
+    for (size_t done=0; done<size && active_[slot]; done+=kScratchSize){
+      size_t n = std::min(kScratchSize, size-done);
+      switch (interp_){
+        case GrainInterp::None:
+          ProcessSlot<GrainInterp::None>(slot, out_left+done, out_right+done, n);
+          break;
+        case GrainInterp::Linear:
+          ProcessSlot<GrainInterp::Linear>(slot, out_left+done, out_right+done, n);
+          break;
+        case GrainInterp::Hermite:
+          ProcessSlot<GrainInterp::Hermite>(slot, out_left+done, out_right+done, n);
+          break;
+      }
+    }
+  }
+#else
+  for (size_t first=0; first<active_count_; first+=kLanes){
+    switch (interp_){
+      case GrainInterp::None:
+        ProcessLaneGroup<GrainInterp::None>(first, out_left, out_right, size);
+        break;
+      case GrainInterp::Linear:
+        ProcessLaneGroup<GrainInterp::Linear>(first, out_left, out_right, size);
+        break;
+      case GrainInterp::Hermite:
+        ProcessLaneGroup<GrainInterp::Hermite>(first, out_left, out_right, size);
+        break;
+    }
+  }
+#endif
+  ReleaseFinished();
+}
+
+/// @brief Reads one stereo frame between idx and idx+1
+/// @param src Sample store, mip-map level or staged slab the grain reads from
+/// @param len Length of the level the grain reads, positions wrap around it
+/// @param idx Integer part of the read position
+/// @param frac Fractional part of the read position, as the low 32 bits of the 32.32 position
+/// @param left Left channel output
+/// @param right Right channel output
+template <GrainInterp interp>
+inline void GrainPoolImpl::ReadFrame(const SampleStore *src, size_t len, size_t idx, uint32_t frac,
+                                     float &left, float &right) const {
+  int16_t l0, r0;
+  src->Read(idx, l0, r0);
+  if (interp == GrainInterp::None){
+    left = s162f(l0);
+    right = s162f(r0);
+    return;
+  }
+  const float f = static_cast<float>(frac) * kFixedScaleInv;
+  size_t next = idx + 1;
+  if (next >= len) next -= len;
+  int16_t l1, r1;
+  src->Read(next, l1, r1);
+  if (interp == GrainInterp::Linear){
+    left = s162f(l0) + f * (s162f(l1) - s162f(l0));
+    right = s162f(r0) + f * (s162f(r1) - s162f(r0));
+    return;
+  }
+  size_t prev = idx > 0 ? idx - 1 : len - 1;
+  size_t next2 = next + 1;
+  if (next2 >= len) next2 -= len;
+  int16_t lm1, rm1, l2, r2;
+  src->Read(prev, lm1, rm1);
+  src->Read(next2, l2, r2);
+  left = Hermite(s162f(lm1), s162f(l0), s162f(l1), s162f(l2), f);
+  right = Hermite(s162f(rm1), s162f(r0), s162f(r1), s162f(r2), f);
+}
+
+#ifndef GRAIN_USE_CMSIS
+/// @brief Advances one lane group of grains across the block. Envelope positions
+///        and fades are advanced for all lanes at once, then each live lane steps its
+///        fixed point read position, reads its sample and is summed into the output
+/// @param first Slot index of the first lane in the group
+template <GrainInterp interp>
+void GrainPoolImpl::ProcessLaneGroup(size_t first, float *out_left, float *out_right, size_t size){
+  VecF env_pos = Load(&env_pos_[first]);
+  const VecF env_inc = Load(&env_inc_[first]);
+  VecF fade = Load(&fade_[first]);
+  const VecF fade_inc = Load(&fade_inc_[first]);
+  Mask live = LoadMask(&active_[first]);
+  const VecF one = Set1(1.0f);
+  const VecF zero = Set1(0.0f);
+  const VecF table_size = Set1(static_cast<float>(GrainWindows::kTableSize));
+  uint64_t *read_pos = &read_pos_[first];
+  const uint64_t *read_inc = &read_inc_[first];
+  const float *const *window = &window_[first];
+  const SampleStore *const *src = &src_[first];
+  const uint8_t *level = &level_[first];
+  const float *pan_left = &pan_left_[first];
+  const float *pan_right = &pan_right_[first];
+
+  alignas(kAlign) int32_t win_idx[kLanes];
+  alignas(kAlign) float win_frac[kLanes];
+  alignas(kAlign) float gain[kLanes];
+
+  for (size_t i=0; i<size; i++){
+    env_pos = env_pos + env_inc;
+    fade = fade + fade_inc;
+    live = live & CmpLe(env_pos, one) & CmpLe(zero, fade);
+    int bits = Bits(live);
+    if (!bits) break;
+
+    /* window table position for every lane at once */
+    VecF win_pos = env_pos * table_size;
+    StoreInt(win_idx, win_pos);
+    Store(win_frac, win_pos - Trunc(win_pos));
+    Store(gain, fade);
+
+    float left = 0.0f, right = 0.0f;
+    for (size_t lane=0; lane<kLanes; lane++){
+      if (!(bits & (1 << lane))) continue;
+      const float *table = window[lane] + win_idx[lane];
+      float env = (table[0] + win_frac[lane] * (table[1] - table[0])) * gain[lane];
+
+      const size_t lvl = level[lane];
+      uint64_t pos = read_pos[lane] + read_inc[lane];
+      if (pos >= level_wrap_[lvl]) pos -= level_wrap_[lvl];
+      read_pos[lane] = pos;
+
+      float l, r;
+      ReadFrame<interp>(src[lane], level_len_[lvl], static_cast<size_t>(pos >> 32),
+                        static_cast<uint32_t>(pos), l, r);
+      left += l * env * pan_left[lane];
+      right += r * env * pan_right[lane];
+    }
+    out_left[i] += left;
+    out_right[i] += right;
+  }
+
+  Store(&env_pos_[first], Masked(live, env_pos));
+  Store(&fade_[first], fade);
+  StoreMask(&active_[first], live);
+}
+#else
+/// @brief Renders a single grain for up to kScratchSize samples (CMSIS path only)
+/// @param slot Index of the grain within the pool
+template <GrainInterp interp>
+void GrainPoolImpl::ProcessSlot(size_t slot, float *out_left, float *out_right, size_t size){
+  float env_pos = env_pos_[slot];
+  uint64_t pos = read_pos_[slot];
+  const float env_inc = env_inc_[slot];
+  float fade = fade_[slot];
+  const float fade_inc = fade_inc_[slot];
+  const float pan_left = pan_left_[slot];
+  const float pan_right = pan_right_[slot];
+  const uint64_t read_inc = read_inc_[slot];
+  const uint64_t wrap_len = level_wrap_[level_[slot]];
+  const size_t len = level_len_[level_[slot]];
+  const float *window = window_[slot];
+  const SampleStore *src = src_[slot];
+
+  size_t n = 0;
+  for (; n<size; n++){
+    env_pos += env_inc;
+    fade += fade_inc;
+    if (env_pos > 1.0f || fade < 0.0f){
+      active_[slot] = 0;
+      break;
+    }
+    pos += read_inc;
+    if (pos >= wrap_len) pos -= wrap_len;
+    float env = GrainWindows::Lookup(window, env_pos) * fade;
+    scratch_env_left_[n] = env * pan_left;
+    scratch_env_right_[n] = env * pan_right;
+    ReadFrame<interp>(src, len, static_cast<size_t>(pos >> 32), static_cast<uint32_t>(pos),
+                      scratch_left_[n], scratch_right_[n]);
+  }
+  env_pos_[slot] = env_pos;
+  fade_[slot] = fade;
+  read_pos_[slot] = pos;
+
+  arm_mult_f32(scratch_left_, scratch_env_left_, scratch_left_, n);
+  arm_mult_f32(scratch_right_, scratch_env_right_, scratch_right_, n);
+  arm_add_f32(out_left, scratch_left_, out_left, n);
+  arm_add_f32(out_right, scratch_right_, out_right, n);
+}
+#endif
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "daisy_pod.h"
+#include "constants_utils.h"
+#include "GrainSimd.h"
+#include "GrainWindow.h"
+#include "GrainPan.h"
+#include "SampleStore.h"
+#include "GrainCache.h"
+#include "SampleMipMap.h"
+
+using namespace daisy;
+
+/* how grains read between source samples when pitch shifted */
+enum class GrainInterp{
+  None,     /* truncate to the nearest earlier sample */
+  Linear,
+  Hermite   /* 4-point, 3rd-order Hermite */
+};
+
+/* which grain gives up its voice when a new grain is triggered on a full pool */
+enum class StealPolicy{
+  None,           /* drop the new grain instead */
+  Oldest,         /* grain that has played for the most samples */
+  Quietest,       /* grain with the lowest envelope level right now */
+  NearestFinish   /* grain with the fewest samples left to play */
+};
+constexpr size_t NUM_STEAL_POLICIES = 4;
+
+/* Structure-of-arrays grain pool. Each grain is one slot across the arrays,
+  so a whole lane group of grains advances in one SIMD op.
+  Playing grains are kept packed in slots [0, active_count_) - that range
+  is the active list and the rest of the pool is the free list. Triggering
+  takes the first free slot and a finished grain is swapped with the last
+  playing one, so trigger and render cost scale with playing grains only.
+  When the pool (or an owner's limit) is full a voice is stolen: the victim
+  fades out over kStealFadeSamples in one of kStealSlots spare slots, so the
+  number of voices - and the CPU they cost - stays fixed.
+  Each grain carries constant-power pan gains fixed when it is triggered.
+  Each grain reads from the mip-map level suited to its pitch, either
+  straight from SDRAM or from a copy of its region staged in internal SRAM
+  by the GrainCache.
+  Storage is provided by GrainPool<max_grains> below */
+class GrainPoolImpl {
+  public:
+    static constexpr size_t kLanes = grainsimd::kLanes;
+    /* owners let callers track groups of grains (eg a chord) as slots move */
+    static constexpr size_t kMaxOwners = 16;
+    /* extra slots for stolen grains to fade out in */
+    static constexpr size_t kStealSlots = 4;
+    /* length of the fade out given to a stolen grain, 2ms at 48kHz */
+    static constexpr float kStealFadeSamples = 96.0f;
+    /* frames staged past a grain's size, covers the interpolation points and
+      the envelope running slightly long from float rounding */
+    static constexpr size_t kStageGuard = 64;
+
+    void Init(const SampleStore *store, size_t audio_len, const SampleMipMap *mips=nullptr);
+    void Reset();
+    bool Trigger(size_t pos, size_t grain_size, float pitch_ratio=1.0f,
+                 WindowShape shape=WindowShape::Hann, uint8_t owner=0, float pan=0.5f,
+                 float gain=1.0f);
+    void ReleaseOwner(uint8_t owner, float fade_samples);
+    void Shed(uint8_t owner);
+    void ProcessBlock(float *out_left, float *out_right, size_t size);
+
+    /* playing grains, including stolen grains still fading out */
+    size_t ActiveCount() const { return active_count_; }
+    /* playing grains of an owner, not counting stolen grains */
+    size_t OwnerCount(uint8_t owner) const { return owner_count_[owner]; }
+    size_t Capacity() const { return max_grains_; }
+    bool Full() const { return active_count_ - releasing_count_ >= max_grains_; }
+
+    void SetStealPolicy(StealPolicy policy) { steal_policy_ = policy; }
+    StealPolicy GetStealPolicy() const { return steal_policy_; }
+    /* caps the grains an owner can play at once, further triggers steal from that owner */
+    void SetOwnerLimit(uint8_t owner, size_t limit) { owner_limit_[owner] = limit; }
+    size_t StealCount() const { return steal_count_; }
+    const GrainCache::Stats& CacheStats() const { return cache_.GetStats(); }
+    void ResetCacheStats() { cache_.ResetStats(); }
+
+    void SetTukeyTaper(float taper);
+    float GetTukeyTaper() const { return windows_.GetTukeyTaper(); }
+    void SetInterpolation(GrainInterp interp) { interp_ = interp; }
+    GrainInterp GetInterpolation() const { return interp_; }
+
+  protected:
+    GrainPoolImpl(uint64_t *read_pos, uint64_t *read_inc, float *env_pos, float *env_inc,
+                  float *fade, float *fade_inc, float *pan_left, float *pan_right,
+                  const float **window, const SampleStore **src,
+                  uint8_t *slab, uint8_t *level, uint8_t *owner, uint32_t *active,
+                  size_t max_grains, size_t capacity, GrainSlabMemory &slab_mem):
+      store_(nullptr), audio_len_(0), num_levels_(1), interp_(GrainInterp::Hermite),
+      steal_policy_(StealPolicy::Quietest), pending_taper_(GrainWindows::kDefaultTaper),
+      taper_pending_(false), cache_(slab_mem),
+      read_pos_(read_pos), read_inc_(read_inc), env_pos_(env_pos), env_inc_(env_inc),
+      fade_(fade), fade_inc_(fade_inc), pan_left_(pan_left), pan_right_(pan_right), window_(window), src_(src), slab_(slab),
+      level_(level), owner_(owner), active_(active),
+      max_grains_(max_grains), capacity_(capacity), active_count_(0), releasing_count_(0),
+      steal_count_(0){}
+
+  private:
+#ifdef GRAIN_USE_CMSIS
+    template <GrainInterp interp>
+    void ProcessSlot(size_t slot, float *out_left, float *out_right, size_t size);
+#else
+    template <GrainInterp interp>
+    void ProcessLaneGroup(size_t first, float *out_left, float *out_right, size_t size);
+#endif
+    template <GrainInterp interp>
+    inline void ReadFrame(const SampleStore *src, size_t len, size_t idx, uint32_t frac,
+                          float &left, float &right) const;
+    void UpdateSources();
+    uint32_t TukeyTablesInUse() const;
+    void ReleaseSlab(size_t slot);
+    void ReleaseFinished();
+    void MoveSlot(size_t from, size_t to);
+    size_t FindVictim(bool same_owner, uint8_t owner) const;
+    size_t MostFaded() const;
+    void StartFade(size_t slot, float fade_samples);
+
+    const SampleStore *store_;
+    size_t audio_len_;
+    /* mip-map levels grains can read from, level 0 is the store itself */
+    const SampleStore *level_src_[SampleMipMap::kNumLevels];
+    size_t level_len_[SampleMipMap::kNumLevels];
+    uint64_t level_wrap_[SampleMipMap::kNumLevels];
+    size_t num_levels_;
+    GrainInterp interp_;
+    StealPolicy steal_policy_;
+    GrainWindows windows_;
+    /* a taper waiting for a Tukey table no playing grain reads */
+    float pending_taper_;
+    bool taper_pending_;
+    GrainPans pans_;
+    GrainCache cache_;
+
+    /* read position in the audio buffer and its per-sample increment, both
+      32.32 fixed point so positions stay exact across the whole buffer */
+    uint64_t *read_pos_;
+    uint64_t *read_inc_;
+    /* grain lifetime position (0-1) used for the envelope, and its increment */
+    float *env_pos_;
+    float *env_inc_;
+    /* gain applied on top of the envelope and its increment - 1 and 0 until
+      the grain is stolen, then ramps down to 0 */
+    float *fade_;
+    float *fade_inc_;
+    /* channel gains from the grain's pan position and level, set at trigger */
+    float *pan_left_;
+    float *pan_right_;
+    /* envelope table each grain was triggered with */
+    const float **window_;
+    /* where each grain reads its audio - the sample store or its staged slab */
+    const SampleStore **src_;
+    uint8_t *slab_;
+    /* mip-map level the grain reads - its read position is in that level's frames */
+    uint8_t *level_;
+    uint8_t *owner_;
+    /* all bits set while the grain is playing, so it can be loaded as a lane mask */
+    uint32_t *active_;
+
+    size_t max_grains_;
+    size_t capacity_;
+    size_t active_count_;
+    /* stolen grains still fading out */
+    size_t releasing_count_;
+    size_t steal_count_;
+    size_t owner_count_[kMaxOwners];
+    size_t owner_limit_[kMaxOwners];
+
+#ifdef GRAIN_USE_CMSIS
+    /* per-grain scratch for the CMSIS mixing path */
+    static constexpr size_t kScratchSize = 64;
+    float scratch_env_left_[kScratchSize];
+    float scratch_env_right_[kScratchSize];
+    float scratch_left_[kScratchSize];
+    float scratch_right_[kScratchSize];
+#endif
+};
+
+/* Grain pool holding up to max_grains grains, eg GrainPool<64> for dense
+  clouds. The SoA arrays hold kStealSlots more for stolen grains to fade out
+  in, rounded up to a whole number of lane groups */
+template <size_t max_grains>
+class GrainPool : public GrainPoolImpl {
+  public:
+    static constexpr size_t kCapacity = ((max_grains + kStealSlots + kLanes - 1) / kLanes) * kLanes;
+
+    /* slab_mem is the grain cache's staging memory, see GrainSlabMemory */
+    GrainPool(GrainSlabMemory &slab_mem):
+      GrainPoolImpl(read_pos_, read_inc_, env_pos_, env_inc_, fade_, fade_inc_, pan_left_,
+                    pan_right_, window_, src_, slab_, level_, owner_, active_, max_grains,
+                    kCapacity, slab_mem){}
+
+  private:
+    alignas(grainsimd::kAlign) uint64_t read_pos_[kCapacity];
+    alignas(grainsimd::kAlign) uint64_t read_inc_[kCapacity];
+    alignas(grainsimd::kAlign) float env_pos_[kCapacity];
+    alignas(grainsimd::kAlign) float env_inc_[kCapacity];
+    alignas(grainsimd::kAlign) float fade_[kCapacity];
+    alignas(grainsimd::kAlign) float fade_inc_[kCapacity];
+    alignas(grainsimd::kAlign) float pan_left_[kCapacity];
+    alignas(grainsimd::kAlign) float pan_right_[kCapacity];
+    const float *window_[kCapacity];
+    const SampleStore *src_[kCapacity];
+    uint8_t slab_[kCapacity];
+    uint8_t level_[kCapacity];
+    uint8_t owner_[kCapacity];
+    alignas(grainsimd::kAlign) uint32_t active_[kCapacity];
+
+    /* the base class points at this object's arrays */
+    GrainPool(const GrainPool&) = delete;
+    GrainPool& operator=(const GrainPool&) = delete;
+};
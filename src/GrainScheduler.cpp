@@ -0,0 +1,53 @@
+#include "GrainScheduler.h"
+
+/// @brief Initialise the scheduler with no grains scheduled
+/// @param sample_rate Audio sample rate in Hz
+void GrainScheduler::Init(float sample_rate){
+  sample_rate_ = sample_rate;
+  density_ = 0.0f;
+  mean_interval_ = 0.0f;
+  next_onset_ = 0.0f;
+  mode_ = SchedulerMode::Async;
+}
+
+/// @brief Sets how many grains start per second, on average in Async mode
+/// @param grains_per_sec Grain density - 0 or less stops new grains
+void GrainScheduler::SetDensity(float grains_per_sec){
+  density_ = grains_per_sec;
+  if (density_ <= 0.0f){
+    mean_interval_ = 0.0f;
+    return;
+  }
+  mean_interval_ = sample_rate_ / density_;
+  /* don't make a faster density wait out an onset scheduled at the old one */
+  if (next_onset_ > mean_interval_) next_onset_ = mean_interval_;
+}
+
+/// @brief Works out which samples of the next block start a grain
+/// @param size Number of samples in the block
+/// @param offsets Filled with the sample offset of each onset, in order
+/// @param max_onsets Size of offsets - any further onsets in the block are skipped
+/// @return Number of onsets written to offsets
+size_t GrainScheduler::NextBlock(size_t size, uint16_t *offsets, size_t max_onsets){
+  if (mean_interval_ <= 0.0f) return 0;
+  size_t count = 0;
+  const float block_len = static_cast<float>(size);
+  while (next_onset_ < block_len){
+    if (count < max_onsets){
+      offsets[count++] = static_cast<uint16_t>(next_onset_);
+    }
+    next_onset_ += NextInterval();
+  }
+  next_onset_ -= block_len;
+  return count;
+}
+
+/// @brief Samples until the onset after this one
+float GrainScheduler::NextInterval(){
+  if (mode_ == SchedulerMode::Sync) return mean_interval_;
+  /* Poisson process - intervals are exponentially distributed,
+    https://en.wikipedia.org/wiki/Poisson_point_process */
+  /* in (0, 1] so the log is finite */
+  float u = 1.0f - rng_.Uniform();
+  return -logf(u) * mean_interval_;
+}
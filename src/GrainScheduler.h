@@ -0,0 +1,42 @@
+#pragma once
+#include "constants_utils.h"
+#include "BlockRng.h"
+
+/* how grain onsets are spaced at a given density */
+enum class SchedulerMode{
+  Sync,   /* fixed time between onsets */
+  Async   /* random (Poisson) onsets with the same average rate */
+};
+
+/* Decides when grains start, from a density in grains per second.
+  Onsets are worked out per block as sample offsets within the block,
+  so grains start on the exact sample regardless of block size */
+class GrainScheduler {
+  public:
+    GrainScheduler(){}
+
+    void Init(float sample_rate);
+    void SetDensity(float grains_per_sec);
+    void SetMode(SchedulerMode mode) { mode_ = mode; }
+    /* restarts the Async onset times from a seed */
+    void Seed(uint32_t seed) { rng_.Seed(seed); }
+    /* schedules the next onset on the first sample of the next block */
+    void Restart() { next_onset_ = 0.0f; }
+
+    size_t NextBlock(size_t size, uint16_t *offsets, size_t max_onsets);
+
+    float GetDensity() const { return density_; }
+    SchedulerMode GetMode() const { return mode_; }
+
+  private:
+    float NextInterval();
+
+    float sample_rate_;
+    float density_;
+    /* average samples between onsets at the current density */
+    float mean_interval_;
+    /* samples from the start of the next block until the next onset */
+    float next_onset_;
+    SchedulerMode mode_;
+    BlockRng rng_;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/* Lane group abstraction for the grain pool. A lane group is a fixed number
+  of grains whose state is advanced together with one vector instruction.
+  - AVX: 8 lanes, host builds compiled with -mavx (benchmarking)
+  - SSE2: 4 lanes, any other x86-64 host
+  - scalar: 4 lanes in plain arrays, used on the Pod (the Cortex-M7 has no
+    float SIMD, so the mixing there goes through CMSIS-DSP instead,
+    see GrainPool.cpp) and anywhere GRAIN_SIMD_SCALAR is defined */
+#if !defined(GRAIN_SIMD_SCALAR) && defined(__AVX__)
+#define GRAIN_SIMD_AVX 1
+#include <immintrin.h>
+#elif !defined(GRAIN_SIMD_SCALAR) && defined(__SSE2__)
+#define GRAIN_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace grainsimd {
+
+#if defined(GRAIN_SIMD_AVX)
+
+constexpr size_t kLanes = 8;
+struct VecF { __m256 v; };
+struct Mask { __m256 v; };
+
+inline VecF Load(const float *p) { return {_mm256_load_ps(p)}; }
+inline void Store(float *p, VecF a) { _mm256_store_ps(p, a.v); }
+inline VecF Set1(float x) { return {_mm256_set1_ps(x)}; }
+inline VecF operator+(VecF a, VecF b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline VecF operator-(VecF a, VecF b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline VecF operator*(VecF a, VecF b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline VecF Trunc(VecF a) { return {_mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)}; }
+inline Mask CmpLe(VecF a, VecF b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline VecF Masked(Mask m, VecF a) { return {_mm256_and_ps(m.v, a.v)}; }
+inline int Bits(Mask m) { return _mm256_movemask_ps(m.v); }
+inline Mask LoadMask(const uint32_t *p) { return {_mm256_load_ps(reinterpret_cast<const float*>(p))}; }
+inline void StoreMask(uint32_t *p, Mask m) { _mm256_store_ps(reinterpret_cast<float*>(p), m.v); }
+/* truncates towards zero, like static_cast<int32_t> */
+inline void StoreInt(int32_t *p, VecF a) {
+  _mm256_store_si256(reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32(a.v));
+}
+
+#elif defined(GRAIN_SIMD_SSE)
+
+constexpr size_t kLanes = 4;
+struct VecF { __m128 v; };
+struct Mask { __m128 v; };
+
+inline VecF Load(const float *p) { return {_mm_load_ps(p)}; }
+inline void Store(float *p, VecF a) { _mm_store_ps(p, a.v); }
+inline VecF Set1(float x) { return {_mm_set1_ps(x)}; }
+inline VecF operator+(VecF a, VecF b) { return {_mm_add_ps(a.v, b.v)}; }
+inline VecF operator-(VecF a, VecF b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline VecF operator*(VecF a, VecF b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline VecF Trunc(VecF a) { return {_mm_cvtepi32_ps(_mm_cvttps_epi32(a.v))}; }
+inline Mask CmpLe(VecF a, VecF b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.v, b.v)}; }
+inline VecF Masked(Mask m, VecF a) { return {_mm_and_ps(m.v, a.v)}; }
+inline int Bits(Mask m) { return _mm_movemask_ps(m.v); }
+inline Mask LoadMask(const uint32_t *p) { return {_mm_load_ps(reinterpret_cast<const float*>(p))}; }
+inline void StoreMask(uint32_t *p, Mask m) { _mm_store_ps(reinterpret_cast<float*>(p), m.v); }
+inline void StoreInt(int32_t *p, VecF a) {
+  _mm_store_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(a.v));
+}
+
+#else
+
+constexpr size_t kLanes = 4;
+struct VecF { float v[kLanes]; };
+struct Mask { bool v[kLanes]; };
+
+inline VecF Load(const float *p) {
+  VecF a;
+  for (size_t i=0; i<kLanes; i++) a.v[i] = p[i];
+  return a;
+}
+inline void Store(float *p, VecF a) { for (size_t i=0; i<kLanes; i++) p[i] = a.v[i]; }
+inline VecF Set1(float x) {
+  VecF a;
+  for (size_t i=0; i<kLanes; i++) a.v[i] = x;
+  return a;
+}
+inline VecF operator+(VecF a, VecF b) { for (size_t i=0; i<kLanes; i++) a.v[i] += b.v[i]; return a; }
+inline VecF operator-(VecF a, VecF b) { for (size_t i=0; i<kLanes; i++) a.v[i] -= b.v[i]; return a; }
+inline VecF operator*(VecF a, VecF b) { for (size_t i=0; i<kLanes; i++) a.v[i] *= b.v[i]; return a; }
+inline VecF Trunc(VecF a) { for (size_t i=0; i<kLanes; i++) a.v[i] = static_cast<float>(static_cast<int32_t>(a.v[i])); return a; }
+inline Mask CmpLe(VecF a, VecF b) {
+  Mask m;
+  for (size_t i=0; i<kLanes; i++) m.v[i] = a.v[i] <= b.v[i];
+  return m;
+}
+inline Mask operator&(Mask a, Mask b) { for (size_t i=0; i<kLanes; i++) a.v[i] = a.v[i] && b.v[i]; return a; }
+inline VecF Masked(Mask m, VecF a) { for (size_t i=0; i<kLanes; i++) if (!m.v[i]) a.v[i] = 0.0f; return a; }
+inline int Bits(Mask m) {
+  int bits = 0;
+  for (size_t i=0; i<kLanes; i++) bits |= (m.v[i] ? 1 : 0) << i;
+  return bits;
+}
+inline Mask LoadMask(const uint32_t *p) {
+  Mask m;
+  for (size_t i=0; i<kLanes; i++) m.v[i] = p[i] != 0;
+  return m;
+}
+inline void StoreMask(uint32_t *p, Mask m) { for (size_t i=0; i<kLanes; i++) p[i] = m.v[i] ? ~0u : 0u; }
+inline void StoreInt(int32_t *p, VecF a) { for (size_t i=0; i<kLanes; i++) p[i] = static_cast<int32_t>(a.v[i]); }
+
+#endif
+
+/* all SoA arrays are aligned to the widest lane group */
+constexpr size_t kAlign = kLanes * sizeof(float);
+
+} // namespace grainsimd
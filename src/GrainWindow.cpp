@@ -0,0 +1,108 @@
+#include "GrainWindow.h"
+#include <algorithm>
+
+const float GrainWindows::start_decay_ = 0.8f;
+const float GrainWindows::decay_rate_ = 5.0f;
+const float GrainWindows::gauss_sigma_ = 0.4f;
+const float GrainWindows::trapezoid_ramp_ = 0.1f;
+
+/// @brief Builds all window tables. Uses the precise libm functions as this
+///        only runs at startup, not per sample
+void GrainWindows::Init(){
+  const float size = static_cast<float>(kTableSize);
+  const float decay_len = 1.0f - start_decay_;
+  const float decay_floor = expf(-decay_rate_);
+  for (size_t i=0; i<=kTableSize; i++){
+    float phase = static_cast<float>(i) / size;
+
+    /* Hann formula from https://uk.mathworks.com/help/signal/ref/hann.html */
+    hann_[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * phase));
+
+    /* Gaussian centred on the grain,
+      see https://uk.mathworks.com/help/signal/ref/gausswin.html */
+    float g = (phase - 0.5f) / (gauss_sigma_ * 0.5f);
+    gaussian_[i] = expf(-0.5f * g * g);
+
+    float ramp = std::min(phase, 1.0f - phase) / trapezoid_ramp_;
+    trapezoid_[i] = std::min(ramp, 1.0f);
+
+    /* hold until start_decay_, then decay at decay_rate_ - rescaled
+      so it lands on zero at the end of the grain. A short ramp at the
+      start stops the onset clicking */
+    float env = 1.0f;
+    if (phase > start_decay_){
+      float t = (phase - start_decay_) / decay_len;
+      env = (expf(-decay_rate_ * t) - decay_floor) / (1.0f - decay_floor);
+    }
+    exp_decay_[i] = env * std::min(phase / 0.01f, 1.0f);
+  }
+  /* guard points for interpolating at phase 1.0 */
+  hann_[kTableSize+1] = gaussian_[kTableSize+1] = 0.0f;
+  trapezoid_[kTableSize+1] = exp_decay_[kTableSize+1] = 0.0f;
+
+  tukey_taper_ = kDefaultTaper;
+  tukey_idx_ = 0;
+  FillTukey(tukey_[0], tukey_taper_);
+
+  tables_[static_cast<size_t>(WindowShape::Hann)] = hann_;
+  tables_[static_cast<size_t>(WindowShape::Tukey)] = tukey_[0];
+  tables_[static_cast<size_t>(WindowShape::Gaussian)] = gaussian_;
+  tables_[static_cast<size_t>(WindowShape::Trapezoid)] = trapezoid_;
+  tables_[static_cast<size_t>(WindowShape::ExpDecay)] = exp_decay_;
+}
+
+/// @brief Builds the Tukey window for a new taper into a table no playing grain
+///        reads, and gives it to grains triggered from now on. Grains already
+///        playing keep the table they started with. Call from the audio callback
+/// @param taper Fraction of the grain spent tapering (0 = rectangle, 1 = Hann)
+/// @param tables_in_use Bit i set while a playing grain reads Tukey table i
+/// @return False if every other table is still in use - nothing changes, so
+///         call again once some of those grains have finished
+bool GrainWindows::SetTukeyTaper(float taper, uint32_t tables_in_use){
+  taper = RoundTaper(taper);
+  if (taper == tukey_taper_) return true;
+  for (size_t i=0; i<kTukeyTables; i++){
+    if (i == tukey_idx_ || (tables_in_use & (1u << i))) continue;
+    FillTukey(tukey_[i], taper);
+    tukey_idx_ = i;
+    tukey_taper_ = taper;
+    tables_[static_cast<size_t>(WindowShape::Tukey)] = tukey_[i];
+    return true;
+  }
+  return false;
+}
+
+size_t GrainWindows::TukeyIndex(const float *table) const{
+  for (size_t i=0; i<kTukeyTables; i++){
+    if (table == tukey_[i]) return i;
+  }
+  return kTukeyTables;
+}
+
+float GrainWindows::RoundTaper(float taper){
+  taper = std::min(std::max(taper, 0.0f), 1.0f);
+  return roundf(taper * kTaperSteps) / kTaperSteps;
+}
+
+/// @brief Fills a table with a Tukey (tapered cosine) window. Each taper is half
+///        a Hann window squeezed to the taper's width, so it's read from the
+///        Hann table - cheap enough to rebuild from the audio callback
+/// @param table Table to fill, kTableSize+2 points
+/// @param taper Fraction of the grain spent tapering, split between both ends
+void GrainWindows::FillTukey(float *table, float taper){
+  taper = std::min(std::max(taper, 0.001f), 1.0f);
+  const float size = static_cast<float>(kTableSize);
+  const float scale = 1.0f / taper;
+  /* https://uk.mathworks.com/help/signal/ref/tukeywin.html */
+  for (size_t i=0; i<=kTableSize; i++){
+    float phase = static_cast<float>(i) / size;
+    float edge = std::min(phase, 1.0f - phase);
+    if (edge < taper * 0.5f){
+      table[i] = Lookup(hann_, edge * scale);
+    }
+    else {
+      table[i] = 1.0f;
+    }
+  }
+  table[kTableSize+1] = 0.0f;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "constants_utils.h"
+
+/* amplitude envelope shapes a grain can be played with */
+enum class WindowShape{
+  Hann,
+  Tukey,      /* flat top with cosine tapers, taper width set by SetTukeyTaper */
+  Gaussian,
+  Trapezoid,  /* flat top with linear ramps */
+  ExpDecay,   /* flat until start_decay_, then exponential decay */
+  NUM_SHAPES
+};
+
+constexpr size_t NUM_WINDOW_SHAPES = static_cast<size_t>(WindowShape::NUM_SHAPES);
+
+/* Precomputed grain window tables. Grains look up their envelope by phase
+  (0-1) with linear interpolation instead of evaluating it per sample.
+  The Tukey window's taper can change while grains play. Grains keep a
+  pointer to the table they started with, so a new taper is built into one
+  of kTukeyTables tables that no playing grain reads - the caller says
+  which are in use - and only then handed to new grains */
+class GrainWindows {
+  public:
+    static constexpr size_t kTableSize = 512;
+    static constexpr size_t kTukeyTables = 4;
+    /* tapers are rounded to 1/kTaperSteps, so a knob moving slowly only
+      rebuilds the table once per step */
+    static constexpr float kTaperSteps = 64.0f;
+    static constexpr float kDefaultTaper = 0.5f;
+
+    GrainWindows(){}
+
+    void Init();
+    bool SetTukeyTaper(float taper, uint32_t tables_in_use);
+    float GetTukeyTaper() const { return tukey_taper_; }
+    /* which Tukey table a window is, kTukeyTables if it's another shape */
+    size_t TukeyIndex(const float *table) const;
+
+    /* table for a shape - kTableSize+2 points, so phase 1.0 and its
+      interpolation neighbour are both in range */
+    const float* GetTable(WindowShape shape) const { return tables_[static_cast<size_t>(shape)]; }
+
+    /// @brief Interpolated window lookup
+    /// @param table Window table from GetTable
+    /// @param phase Position within the grain's lifetime (from 0 - 1)
+    static inline float Lookup(const float *table, float phase){
+      float pos = phase * static_cast<float>(kTableSize);
+      size_t idx = static_cast<size_t>(pos);
+      float frac = pos - static_cast<float>(idx);
+      return table[idx] + frac * (table[idx+1] - table[idx]);
+    }
+
+  private:
+    static const float start_decay_;
+    static const float decay_rate_;
+    static const float gauss_sigma_;
+    static const float trapezoid_ramp_;
+
+    static float RoundTaper(float taper);
+    void FillTukey(float *table, float taper);
+
+    float hann_[kTableSize+2];
+    float gaussian_[kTableSize+2];
+    float trapezoid_[kTableSize+2];
+    float exp_decay_[kTableSize+2];
+    /* Tukey tables for the current taper and the last few, which grains
+      started under them may still be reading */
+    float tukey_[kTukeyTables][kTableSize+2];
+    size_t tukey_idx_ = 0;
+    float tukey_taper_ = kDefaultTaper;
+    const float *tables_[NUM_WINDOW_SHAPES];
+};
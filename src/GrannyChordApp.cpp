@@ -10,11 +10,14 @@
 GrannyChordApp* GrannyChordApp::instance_ = nullptr;
 
 /// @brief Initialises app state and members and goes through app startup process
-/// @param left Left channel audio data buffer
-/// @param right Right channel audio data buffer
-void GrannyChordApp::Init(int16_t *left, int16_t *right){
-  left_buf_ = left, right_buf_ = right;
-  pod_.SetAudioBlockSize(2);
+/// @param sample_buf SDRAM buffer audio is loaded or recorded into
+/// @param buf_size Size of sample_buf in int16 samples
+/// @param mip_buf SDRAM buffer the mip-map levels are built in
+/// @param mip_buf_size Size of mip_buf in int16 samples
+void GrannyChordApp::Init(int16_t *sample_buf, size_t buf_size, int16_t *mip_buf, size_t mip_buf_size){
+  samples_.Init(sample_buf, buf_size);
+  mips_.Init(mip_buf, mip_buf_size);
+  pod_.SetAudioBlockSize(BLOCK_SIZE);
   pod_.SetAudioSampleRate(SaiHandle::Config::SampleRate::SAI_48KHZ);
   curr_state_ = AppState::SelectFile;
   // SetupTimer();
@@ -25,14 +28,21 @@ void GrannyChordApp::Init(int16_t *left, int16_t *right){
     pod_.UpdateLeds();
     return;
   }
-  loadmeter.Init(pod_.AudioSampleRate(), pod_.AudioBlockSize());
-  InitFX();
+  /* a faster average than the default 1Hz, so the load governor reacts in time */
+  loadmeter.Init(pod_.AudioSampleRate(), pod_.AudioBlockSize(), 10.0f);
+  fx_.Init(SAMPLE_RATE_FLOAT);
+  #ifdef STAGE_PROFILER
+  stage_profiler.Init();
+  #endif
   InitPrevParamVals();
+  /* fields only reach the audio callback once they change from here */
+  ui_params_ = kDefaultSynthParams;
+  applied_params_ = ui_params_;
   InitColours();
   SetLedAppState();
   pod_.UpdateLeds();
-  SeedRng();
-  synth_.Init(left_buf_, right_buf_, 0);
+  synth_.Init(&samples_, 0);
+  pod_.midi.StartReceive();
   pod_.StartAdc();
 }
 
@@ -50,6 +60,20 @@ void GrannyChordApp::Run(){
     }
     UpdateUI();
     UpdateParams();
+    HandleMidi(pod_.midi);
+    #ifdef DEBUG_MODE
+    LogLoad();
+    #endif
+    #ifdef STAGE_PROFILER
+    /* a block overrunning leaves the stage figures behind it */
+    if (loadmeter.GetNumOverruns() != logged_overruns_){
+      logged_overruns_ = loadmeter.GetNumOverruns();
+      uint32_t when;
+      loadmeter.GetOverrunTimes(&when, 1);
+      pod_.seed.PrintLine("audio block overran at %ums, %u overruns", when, logged_overruns_);
+      LogStages();
+    }
+    #endif
     System::Delay(1);
   }
 }
@@ -111,6 +135,73 @@ void GrannyChordApp::HandleStateChange(){
   }
 }
 
+#ifdef DEBUG_MODE
+/// @brief Prints the CPU load, its tail, what the load governor has shed and the
+///        grain cache counters, once a second
+void GrannyChordApp::LogLoad(){
+  uint32_t now = System::GetNow();
+  if (now - last_load_log_ < 1000) return;
+  last_load_log_ = now;
+  if (curr_state_ != AppState::Synthesis && curr_state_ != AppState::ChordMode) return;
+  const LoadGovernor &gov = synth_.GetGovernor();
+  DebugPrint(pod_, "load avg %.2f p99 %.2f p99.9 %.2f max %.2f overruns %u | level %u/%u sheds %u | grains %u limit %u",
+             loadmeter.GetAvgCpuLoad(), loadmeter.GetCpuLoadPercentile(99.0f),
+             loadmeter.GetCpuLoadPercentile(99.9f), loadmeter.GetMaxCpuLoad(), loadmeter.GetNumOverruns(),
+             gov.Level(), gov.MaxLevel(), gov.ShedCount(),
+             synth_.GetActiveGrains(), synth_.GetGrainLimit());
+  /* misses when full call for more slabs, misses on size for longer ones */
+  const GrainCache::Stats &cache = synth_.GetCacheStats();
+  DebugPrint(pod_, "cache hits %u misses full %u size %u", cache.hits, cache.misses_full, cache.misses_size);
+}
+#endif
+
+#ifdef STAGE_PROFILER
+/// @brief Prints what each stage of the audio callback has cost per block since
+///        the last call, in ticks and as a share of the block time, then starts
+///        the figures again
+void GrannyChordApp::LogStages(){
+  const float budget = static_cast<float>(stage_profiler.TicksPerSecond()) * pod_.AudioBlockSize()
+                       / pod_.AudioSampleRate();
+  pod_.seed.PrintLine("stage      blocks      min      avg      p99      max  p99%%");
+  for (size_t i=0; i<StageProfiler::kNumStages; i++){
+    ProfileStage stage = static_cast<ProfileStage>(i);
+    StageStats stats;
+    if (!stage_profiler.Read(stage, stats)) continue;
+    pod_.seed.PrintLine("%-8s %8u %8u %8u %8u %8u %5.1f", StageProfiler::StageName(stage),
+                        stats.blocks, stats.min, stats.avg, stats.p99, stats.max,
+                        100.0f * stats.p99 / budget);
+  }
+  stage_profiler.Reset();
+}
+#endif
+
+/// @brief Passes MIDI notes on to the synth's voices while it is playing. Works
+///        with any libDaisy MIDI handler, eg the Pod's TRS/UART port or USB
+/// @param midi MIDI handler to read events from
+template <typename Transport>
+void GrannyChordApp::HandleMidi(MidiHandler<Transport> &midi){
+  midi.Listen();
+  while (midi.HasEvents()){
+    MidiEvent event = midi.PopEvent();
+    if (curr_state_ != AppState::Synthesis && curr_state_ != AppState::ChordMode) continue;
+    switch (event.type){
+      case NoteOn: {
+        /* the voices only start in the grain cloud, not chord mode */
+        if (curr_state_ != AppState::Synthesis) break;
+        NoteOnEvent note = event.AsNoteOn();
+        synth_.PostNoteOn(note.note, note.velocity);
+        break;
+      }
+      case NoteOff:
+        /* but a note held while switching to chord mode still has to end */
+        synth_.PostNoteOff(event.AsNoteOff().note);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
 void GrannyChordApp::UpdateParams(){
   if (curr_state_==AppState::Synthesis){
     UpdateSynthParams();
@@ -134,9 +225,24 @@ void GrannyChordApp::HandleEncoderIncrement(int encoder_inc){
     HandleFileSelection(encoder_inc);
   }
 
+  /* in synthesis mode the encoder selects the grain envelope shape */
+  if (curr_state_ == AppState::Synthesis){
+    synth_.CycleWindowShape(encoder_inc);
+    DebugPrint(pod_, "window shape %d", static_cast<int>(synth_.GetWindowShape()));
+  }
+
   if (curr_state_ == AppState::ChordMode){
-    std::vector<float> ratios = chord_gen_.GetRatios(encoder_inc);
-    synth_.EnqueueChord(ratios);
+    /* turning with button 2 held steps the inversion instead of queueing a chord */
+    if (pod_.button2.Pressed()){
+      button2_combo_ = true;
+      CycleChordInversion(encoder_inc);
+      return;
+    }
+    ChordRatios ratios = chord_gen_.GetRatios(encoder_inc);
+    if (!synth_.EnqueueChord(ratios)){
+      DebugPrint(pod_, "chord queue full");
+      return;
+    }
     DebugPrint(pod_, "queued chord ");
     System::Delay(5);
     for (size_t i =0; i<ratios.size(); i++){
@@ -203,8 +309,20 @@ void GrannyChordApp::ButtonHandler(){
     HandleButton1();
   }
 
+  #ifdef STAGE_PROFILER
+  /* holding button 2 in synthesis mode prints the stage profile - in chord
+    mode it's held to reach the inversion and tuning */
+  if (curr_state_==AppState::Synthesis && pod_.button2.TimeHeldMs()>1000.0f){
+    while (!pod_.button2.FallingEdge()){
+      pod_.button2.Debounce();
+    }
+    LogStages();
+    return;
+  }
+  #endif
   if (pod_.button2.FallingEdge()){
-    HandleButton2();
+    if (!button2_combo_) HandleButton2();
+    button2_combo_ = false;
   }
 
 }
@@ -216,7 +334,12 @@ void GrannyChordApp::HandleButton1(){
       NextSynthMode();
       return;
     case AppState::ChordMode:
-      CycleChordPlaybackMode();
+      /* with button 2 held, button 1 switches the tuning instead */
+      if (pod_.button2.Pressed()){
+        button2_combo_ = true;
+        ToggleChordTuning();
+      }
+      else CycleChordPlaybackMode();
       return;
     default:
       return;
@@ -263,7 +386,9 @@ void GrannyChordApp::HandleFileSelection(int32_t encoder_inc){
   }
   pod_.UpdateLeds();
   int file_count = filemgr_.GetFileCount();
-  file_idx_ = (file_idx_ + encoder_inc + file_count) % file_count;
+  /* no card, or no WAVs on it */
+  if (file_count == 0) return;
+  file_idx_ =(file_idx_ + encoder_inc + file_count) % file_count;
   filemgr_.GetName(file_idx_,fname_);
   DebugPrint(pod_, "selected file %d %s",file_idx_,fname_);
   System::Delay(5);
@@ -272,7 +397,7 @@ void GrannyChordApp::HandleFileSelection(int32_t encoder_inc){
 /// @brief Initialises file manager, sets audio data buffers and scans SD card for WAV files
 /// @return True on successful initialisation, false if init fails or no WAV files found
 bool GrannyChordApp::InitFileMgr(){
-  filemgr_.SetBuffers(left_buf_,right_buf_);
+  filemgr_.SetSampleStore(&samples_, &mips_);
   if (!filemgr_.Init())return false;
 
   return filemgr_.ScanWavFiles();
@@ -280,9 +405,15 @@ bool GrannyChordApp::InitFileMgr(){
 
 /// @brief Calls synth initialisation function, passes audio data buffers and audio length
 void GrannyChordApp::InitSynth(){
-  synth_.Init(left_buf_, right_buf_, filemgr_.GetSamplesPerChannel());
+  /* the store's length is the loaded file's or the recording's, whichever is in it */
+  synth_.Init(&samples_, samples_.Length(), &mips_);
   InitPrevParamVals();
-  DebugPrint(pod_,"synth init ok - samples %u",filemgr_.GetSamplesPerChannel());
+  /* Init put the synth back to its defaults - have the callback apply every
+    knob value again, not only the ones that change. The callback doesn't read
+    applied_params_ until the state is Synthesis */
+  applied_params_ = kUnappliedParams;
+  params_.Publish(ui_params_);
+  DebugPrint(pod_,"synth init ok - samples %u",static_cast<unsigned>(samples_.Length()));
 }
 
 /// @brief Initialises WAV playback state, resets playhead, sets current file audio length
@@ -300,11 +431,15 @@ void GrannyChordApp::InitPlayback(){
   pod_.StartAudio(AudioCallback);
 }
 
-/// @brief Initialises RecordIn state, clears audio buffers
+/// @brief Initialises RecordIn state, clears the sample store and sets it to stereo
 void GrannyChordApp::InitRecordIn(){
-  memset(left_buf_, 0, CHNL_BUF_SIZE_ABS);
-  memset(right_buf_, 0, CHNL_BUF_SIZE_ABS);
+  samples_.Clear();
+  samples_.SetChannels(2);
+  /* the levels belong to the previous file, recordings play at full rate only */
+  mips_.Clear();
   record_in_pos_ = 0;
+  /* audio is stopped when recording starts from file selection */
+  pod_.StartAudio(AudioCallback);
 }
 
 // /// @brief Initialise object for recording out to SD card
@@ -316,35 +451,17 @@ void GrannyChordApp::InitWavWriter(){
   sd_writer_.Init(cfg);
 }
 
-/// @brief initialise reverb, compressor, filter configs for FX section 
-void GrannyChordApp::InitFX(){
-  limiter_.Init();
-  reverb_.Init(SAMPLE_RATE_FLOAT);
-  reverb_.SetMix(0.0f);
-  reverb_.SetFeedback(0.0f);
-  lowpass_moog_.Init(SAMPLE_RATE_FLOAT);
-  lowpass_moog_.SetFreq(LOPASS_UPPER_BOUND);
-  lowpass_moog_.SetRes(0.7f);
-  
-  hipass_.Init();
-  hipass_.SetFilterMode(daisysp::OnePole::FilterMode::FILTER_MODE_HIGH_PASS);
-  hipass_.SetFrequency(HIPASS_LOWER_BOUND);
-
-  hicut_.SetFilterMode(daisysp::OnePole::FilterMode::FILTER_MODE_LOW_PASS);
-  hicut_.SetFrequency(HICUT_FREQ);
-}
-
 /// @brief Initialise previous parameter value arrays to defaults
 void GrannyChordApp::InitPrevParamVals(){
   /* set regular synth parameters */
   for (int i=0; i < NUM_SYNTH_MODES;i++){
-    if (i<3){
+    if (i<static_cast<int>(SynthMode::Reverb)){
       prev_param_k1[i] = 0.5f;
       prev_param_k2[i] = 0.5f;
       prev_k1_pos[i]=0.5f;
       prev_k2_pos[i]=0.5f;
     }
-    /* set reverb values to 0.05 initially */
+    /* set reverb and filter values to 0.05 initially */
     else {
       prev_param_k1[i]=0.05f;
       prev_param_k2[i]=0.05f;
@@ -364,9 +481,22 @@ void GrannyChordApp::AudioCallback(AudioHandle::InputBuffer in, AudioHandle::Out
 }
 
 void GrannyChordApp::ProcessAudio(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size){
+  loadmeter.OnBlockStart();
+  ProcessState(in, out, size);
+  #ifdef STAGE_PROFILER
+  stage_profiler.EndBlock();
+  #endif
+  loadmeter.OnBlockEnd();
+  if (curr_state_ == AppState::Synthesis || curr_state_ == AppState::ChordMode){
+    synth_.GovernLoad(loadmeter.GetAvgCpuLoad(), size);
+  }
+}
+
+/// @brief Runs the audio processing for the current app state
+void GrannyChordApp::ProcessState(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size){
   switch(curr_state_){
     case AppState::PlayWAV:
-      if (wav_playhead_>= filemgr_.GetSamplesPerChannel() -1){
+      if (wav_playhead_ + 1 >= samples_.Length()){
         instance_->pod_.StopAudio();
         DebugPrint(pod_, "stopped audio > len"); 
         return;
@@ -392,9 +522,11 @@ void GrannyChordApp::ProcessAudio(AudioHandle::InputBuffer in, AudioHandle::Outp
 /// @param size Number of samples to process in this call
 void GrannyChordApp::ProcessWAVPlayback(AudioHandle::OutputBuffer out, size_t size){
   for (size_t i=0; i<size; i++){
-    if (wav_playhead_ < filemgr_.GetSamplesPerChannel()){
-      out[0][i] = s162f(left_buf_[wav_playhead_]);
-      out[1][i] = s162f(right_buf_[wav_playhead_]);
+    if (wav_playhead_ < samples_.Length()){
+      int16_t left, right;
+      samples_.Read(wav_playhead_, left, right);
+      out[0][i] = s162f(left);
+      out[1][i] = s162f(right);
       wav_playhead_++;
     }
   }
@@ -406,70 +538,50 @@ void GrannyChordApp::ProcessWAVPlayback(AudioHandle::OutputBuffer out, size_t si
 /// @param size Number of samples to process in this call
 void GrannyChordApp::ProcessRecordIn(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size){
   const size_t MAX_RECORDING_LEN = 120*48000; /* 120s @ 48kHZ */
+  /* a stereo store holds half the frames a mono file could fill it with */
+  const size_t max_len = MAX_RECORDING_LEN < samples_.MaxFrames() ? MAX_RECORDING_LEN : samples_.MaxFrames();
   for (size_t i=0; i<size;i++){
     /* send audio in straight to output for monitoring */
     out[0][i]=in[0][i];
     out[1][i]=in[1][i];
-    /* record audio in to SDRAM buffers */
-    left_buf_[record_in_pos_] = in[0][i];
-    right_buf_[record_in_pos_] = in[1][i];
+    /* record audio in to the SDRAM sample store */
+    samples_.Write(record_in_pos_, f2s16(in[0][i]), f2s16(in[1][i]));
     /* wrap around recording length - if it exceeds 120s,
       the start of the recording will be overwritten */
-    record_in_pos_ = (record_in_pos_+1)%MAX_RECORDING_LEN;
+    record_in_pos_ = (record_in_pos_+1)%max_len;
+    /* once it has wrapped the whole length holds audio */
+    if (record_in_pos_ == 0) samples_.SetLength(max_len);
   }
+  /* the synth and playback read the recorded length from the store */
+  if (record_in_pos_ > samples_.Length()) samples_.SetLength(record_in_pos_);
 }
 
 /// @brief Process audio through granular synth and mix to output buffer
 /// @param out Output audio buffer
 /// @param size Number of samples to process in this call
 void GrannyChordApp::ProcessSynthesis(AudioHandle::OutputBuffer out, size_t size, bool process_chord){
-  Sample samp;
-  for (size_t i=0; i<size; i++){ 
-    if (process_chord){
-      if (!synth_.ChordActive() && !synth_.ChordQueueEmpty()){
-        synth_.TriggerChord();
-      }
-      samp = synth_.ProcessChord();
-    }
-    else {
-      samp = synth_.ProcessGrains();
-    }
-
-    Sample processed = ProcessFX(samp);
-    limiter_.ProcessBlock(&processed.left, 1, 0.5f);
-    limiter_.ProcessBlock(&processed.right, 1, 0.5f);
-    out[0][i] = processed.left;
-    out[1][i] = processed.right;
-
-    if (recording_out_ && sd_writer_.GetLengthSeconds()<MAX_REC_OUT_LEN){
-      temp_interleaved_buf_[0]=out[0][i];
-      temp_interleaved_buf_[1]=out[1][i];
-      sd_writer_.Sample(temp_interleaved_buf_);
+  ApplyParams();
+  fx_.Update(size);
+  /* render the grains for the whole block straight into the output buffers */
+  if (process_chord){
+    if (!synth_.ChordActive() && !synth_.ChordQueueEmpty()){
+      synth_.TriggerChord();
     }
+    synth_.ProcessChordBlock(out[0], out[1], size);
+  }
+  else {
+    synth_.ProcessBlock(out[0], out[1], size);
   }
-}
-
-Sample GrannyChordApp::ProcessFX(Sample in){
-  Sample out;
-  /* hipass: remove rumble */
-  out.left = hipass_.Process(in.left);
-  out.right = hipass_.Process(in.right);
-  // out.left = comp_.Process(in.left);
-  // out.right = comp_.Process(in.right);
-
-  /* apply lowpass filter */
-  out.left = lowpass_moog_.Process(out.left);
-  out.right = lowpass_moog_.Process(out.right);
-
-  /* apply reverb */
-  reverb_.ProcessMix(out.left, out.right, &out.left, &out.right);
-  out.left = hicut_.Process(out.left);
-  out.right = hicut_.Process(out.right);
-
-  limiter_.ProcessBlock(&out.left, 1, 0.5f);
-  limiter_.ProcessBlock(&out.right, 1, 0.5f);
 
-  return out;
+  fx_.ProcessBlock(out[0], out[1], size);
+  /* the length is checked once a block, so a recording may run a block over */
+  if (!recording_out_ || sd_writer_.GetLengthSeconds()>=MAX_REC_OUT_LEN) return;
+  PROFILE_STAGE(WavWriter);
+  for (size_t i=0; i<size; i++){ 
+    temp_interleaved_buf_[0]=out[0][i];
+    temp_interleaved_buf_[1]=out[1][i];
+    sd_writer_.Sample(temp_interleaved_buf_);
+  }
 }
 
 /// @brief Record granular synth or chord output audio to SD card
@@ -497,7 +609,7 @@ void GrannyChordApp::NextSynthMode(){
   prev_k1_pos[mode_idx] = MapKnobDeadzone(pod_.knob1.Process());
   prev_k2_pos[mode_idx] = MapKnobDeadzone(pod_.knob2.Process());
   mode_idx++;
-  if (mode_idx>3) mode_idx =0;
+  if (mode_idx>=NUM_SYNTH_MODES) mode_idx =0;
   curr_synth_mode_ = static_cast<SynthMode>(mode_idx);
   DebugPrintMode(curr_synth_mode_);
   SetLedSynthMode();
@@ -516,7 +628,7 @@ void GrannyChordApp::PrevSynthMode(){
   // knob1_latched = false;
   // knob2_latched = false;  
   mode_idx --;
-  if (mode_idx<0) mode_idx=3;
+  if (mode_idx<0) mode_idx=NUM_SYNTH_MODES-1;
   curr_synth_mode_ = static_cast<SynthMode>(mode_idx);
   prev_k1_pos[mode_idx] = MapKnobDeadzone(pod_.knob1.Process());
   prev_k2_pos[mode_idx] = MapKnobDeadzone(pod_.knob2.Process());
@@ -562,79 +674,103 @@ void GrannyChordApp::UpdateSynthParams(){
     prev_param_k2[mode_idx] = knob2_val;
     prev_k2_pos[mode_idx] = knob2_val;
   }
+  if (knob1_latched || knob2_latched){
+    params_.Publish(ui_params_);
+  }
   System::Delay(5);
 }
 
-/// @brief Updates synth parameters from hardware knob 1 input
+/// @brief Picks up the latest parameters from the UI loop and applies the ones that
+///        have changed. Called at the start of each audio block
+void GrannyChordApp::ApplyParams(){
+  SynthParams p;
+  if (!params_.Read(p)) return;
+  synth_.SetParams(p, applied_params_);
+  fx_.SetParams(p, applied_params_);
+  applied_params_ = p;
+}
+
+/// @brief Updates the UI copy of the synth parameters from hardware knob 1 input
 /// @param knob1_val float between 0-1 from knob input
 /// @param mode current synth mode that determines which parameters to update
 void GrannyChordApp::UpdateKnob1SynthParams(float knob1_val, SynthMode mode){
   switch (mode){
     case SynthMode::Size_Position:
-      synth_.SetGrainSize(knob1_val);
+      ui_params_.grain_size = knob1_val;
+      break;
+    case SynthMode::Pitch_Density:
+      ui_params_.pitch = knob1_val;
       break;
-    case SynthMode::Pitch_ActiveGrains:
-      synth_.SetPitchRatio(knob1_val);
+    case SynthMode::Pan_Width:
+      ui_params_.pan = knob1_val;
+      break;
+    case SynthMode::Window:
+      ui_params_.window_taper = knob1_val;
       break;
     case SynthMode::Reverb:
-       /* set reverb feedback ie tail length */
-      reverb_.SetFeedback(knob1_val);
+      ui_params_.reverb_feedback = knob1_val;
       break;
     case SynthMode::Filter:
-      /* map knob value to frequency range with an exponential curve */
-      knob1_val = fmap(knob1_val, LOPASS_LOWER_BOUND, LOPASS_UPPER_BOUND, daisysp::Mapping::EXP);
-      /* set cutoff frequency of low pass moog filter */
-      lowpass_moog_.SetFreq(knob1_val);
+      ui_params_.lowpass = knob1_val;
       break;
   }
 }
 
-/// @brief Updates synth parameters from hardware knob 2 input
-/// @param knob1_val float between 0-1 from knob input
+/// @brief Updates the UI copy of the synth parameters from hardware knob 2 input
+/// @param knob2_val float between 0-1 from knob input
 /// @param mode current synth mode that determines which parameters to update
 void GrannyChordApp::UpdateKnob2SynthParams(float knob2_val, SynthMode mode){
   switch (mode){
     case SynthMode::Size_Position:
-      synth_.SetSpawnPos(knob2_val);
+      ui_params_.spawn_pos = knob2_val;
+      break;
+    case SynthMode::Pitch_Density:
+      ui_params_.density = knob2_val;
+      break;
+    case SynthMode::Pan_Width:
+      ui_params_.pan_width = knob2_val;
       break;
-    case SynthMode::Pitch_ActiveGrains:
-      synth_.SetTargetActiveGrains(knob2_val);
+    case SynthMode::Window:
       break;
     case SynthMode::Reverb:
-      reverb_.SetMix(knob2_val);
+      ui_params_.reverb_mix = knob2_val;
       break;
     case SynthMode::Filter:
-      /* map knob value to frequency range with linear curve */
-      knob2_val = fmap(knob2_val, HIPASS_LOWER_BOUND, HIPASS_UPPER_BOUND, daisysp::Mapping::EXP);
-      /* set cutoff frequency for high pass filter */
-      hipass_.SetFrequency(knob2_val);
+      ui_params_.hipass = knob2_val;
       break;
   }
 }
 
 void GrannyChordApp::CycleChordPlaybackMode(){
   chord_gen_.CyclePlaybackMode();
-  std::string s = chord_gen_.GetModeName();
-  DebugPrint(pod_, "%s", s);
+  DebugPrint(pod_, "%s", chord_gen_.GetModeName());
 }
 
 void GrannyChordApp::CycleChordScale(){
-  std::string s;
   switch (chord_gen_.GetMode()){
     case ChordPlaybackMode::Chord:
       chord_gen_.CycleChord();
-      s = chord_gen_.GetChordName();
-      DebugPrint(pod_, "%s", s);
+      DebugPrint(pod_, "%s", chord_gen_.GetChordName());
       return;
     case ChordPlaybackMode::Arpeggio:
     case ChordPlaybackMode::Scale:
       chord_gen_.CycleScale();
-      s = chord_gen_.GetScaleName();
-      DebugPrint(pod_, "%s", s);
+      DebugPrint(pod_, "%s", chord_gen_.GetScaleName());
       return;
   }
 }
 
+void GrannyChordApp::CycleChordInversion(int32_t increment){
+  chord_gen_.CycleInversion(increment);
+  DebugPrint(pod_, "inversion %u", static_cast<unsigned>(chord_gen_.GetInversion()));
+}
+
+void GrannyChordApp::ToggleChordTuning(){
+  bool just = chord_gen_.GetTuning() == Tuning::Just;
+  chord_gen_.SetTuning(just ? Tuning::Equal : Tuning::Just);
+  DebugPrint(pod_, "%s tuning", just ? "equal" : "just");
+}
+
 void GrannyChordApp::ChangeChordKey(){
   float knob_val = MapKnobDeadzone(pod_.knob1.Process());
   knob_val = round(fmap(knob_val, 0.0f, 12.0f));
@@ -644,7 +780,8 @@ void GrannyChordApp::ChangeChordKey(){
 
 void GrannyChordApp::ChangeChordSpawnPos(){
   float knob_val = MapKnobDeadzone(pod_.knob2.Process());
-  synth_.SetSpawnPos(knob_val);
+  ui_params_.spawn_pos = knob_val;
+  params_.Publish(ui_params_);
   /* set synth parameter tracking arrays with new value */
   prev_param_k2[0] = knob_val;
   prev_k2_pos[0] = knob_val;
@@ -685,8 +822,14 @@ void GrannyChordApp::DebugPrintMode(SynthMode mode){
     case SynthMode::Size_Position:
       DebugPrint(pod_, "State now in: SizePos");
       return;
-    case SynthMode::Pitch_ActiveGrains:
-      DebugPrint(pod_, "State now in: PitchGrains");
+    case SynthMode::Pitch_Density:
+      DebugPrint(pod_, "State now in: PitchDensity");
+      return;
+    case SynthMode::Pan_Width:
+      DebugPrint(pod_, "State now in: PanWidth");
+      return;
+    case SynthMode::Window:
+      DebugPrint(pod_, "State now in: Window");
       return;
     case SynthMode::Reverb:
       DebugPrint(pod_, "State now in: Reverb");
@@ -705,6 +848,7 @@ void GrannyChordApp::InitColours(){
   colours.ORANGE.Init(Color::PresetColor::GOLD);
   colours.YELLOW.Init(255,255,0);
   colours.PINK.Init(255,0,255);
+  colours.PURPLE.Init(128,0,255);
   colours.OFF.Init(0,0,0);
 }
 
@@ -740,13 +884,19 @@ void GrannyChordApp::SetLedAppState(){
 void GrannyChordApp::SetLedSynthMode(){
   if (curr_state_ == AppState::Synthesis){
     switch(curr_synth_mode_){
-      /* led2 blue / cyan / orange / yellow */
+      /* led2 blue / cyan / orange / purple / yellow / green */
       case SynthMode::Size_Position:
         pod_.led2.SetColor(colours.BLUE);
         break;
-      case SynthMode::Pitch_ActiveGrains:
+      case SynthMode::Pitch_Density:
         pod_.led2.SetColor(colours.CYAN);
         break;
+      case SynthMode::Pan_Width:
+        pod_.led2.SetColor(colours.ORANGE);
+        break;
+      case SynthMode::Window:
+        pod_.led2.SetColor(colours.PURPLE);
+        break;
       case SynthMode::Reverb:
       pod_.led2.SetColor(colours.YELLOW);
         break;
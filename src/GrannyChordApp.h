@@ -5,9 +5,13 @@
 #include "AudioFileManager.h"
 #include "debug_print.h"
 #include "DaisySP-LGPL-FX/compressor.h"
-#include "DaisySP-LGPL-FX/moogladder.h"
+#include "FxChain.h"
+#include "StageProfiler.h"
 #include "StereoRotator.h"
 #include "AppState.h"
+#include "SynthParams.h"
+#include "ParamSnapshot.h"
+#include "ParamSmoother.h"
 
 using namespace daisy;
 using namespace daisysp;
@@ -17,22 +21,23 @@ class GrannyChordApp {
   GrannyChordApp(DaisyPod& pod, GranularSynth& synth, AudioFileManager& filemgr,\
                 ReverbSc &reverb)
         : pod_(pod), synth_(synth), 
-          filemgr_(filemgr), reverb_(reverb){
+          filemgr_(filemgr), fx_(reverb){
             instance_ = this;
           };
 
-    void Init(int16_t *left, int16_t *right);
+    void Init(int16_t *sample_buf, size_t buf_size, int16_t *mip_buf, size_t mip_buf_size);
     void Run();
 
     CpuLoadMeter loadmeter;
 
     static void AudioCallback(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size);
     void ProcessAudio(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size);
+    void ProcessState(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size);
     static GrannyChordApp* instance_;
 
   private:
     DaisyPod &pod_;
-    GranularSynth synth_;
+    GranularSynth &synth_;
     AudioFileManager &filemgr_;
     FIL *file_;
     ChordMode chord_gen_;
@@ -47,17 +52,13 @@ class GrannyChordApp {
 
 
     /* audio FX and filters */
-    Limiter limiter_;
-    ReverbSc& reverb_;
-    MoogLadder lowpass_moog_;
-    OnePole hipass_;
+    FxChain fx_;
     StereoRotator rotator_;
-    /* filter to reduce high end noise */
-    OnePole hicut_;
 
-    /* audio data channel buffers */
-    int16_t *left_buf_;
-    int16_t *right_buf_;
+    /* interleaved audio data, loaded from file or recorded in */
+    SampleStore samples_;
+    /* decimated copies of samples_ for pitched up grains */
+    SampleMipMap mips_;
 
     int file_idx_ = 0;
     size_t wav_playhead_ = 0;
@@ -99,7 +100,6 @@ class GrannyChordApp {
     bool InitFileMgr();
     void InitPlayback();
     void InitSynth();
-    void InitFX();
     void InitRecordIn();
     void InitWavWriter();
     void InitPrevParamVals();
@@ -114,11 +114,24 @@ class GrannyChordApp {
 
     bool UserTriggeredChord();
 
+    /* CPU load logging, see LoadGovernor */
+    #ifdef DEBUG_MODE
+    uint32_t last_load_log_ = 0;
+    void LogLoad();
+    #endif
+    /* per stage figures from the stage profiler, built with -DSTAGE_PROFILER,
+      printed again each time the load meter counts a new overrun */
+    uint32_t logged_overruns_ = 0;
+    void LogStages();
+
+    /* MIDI note input driving the synth's voices */
+    template <typename Transport>
+    void HandleMidi(MidiHandler<Transport> &midi);
+
     /* audio input/output/recording methods based on state */
     void ProcessWAVPlayback(AudioHandle::OutputBuffer out, size_t size);
     void ProcessRecordIn(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size);
     void ProcessSynthesis(AudioHandle::OutputBuffer out, size_t size, bool process_chord);
-    Sample ProcessFX(Sample in);
     // void ProcessChordMode(AudioHandle::OutputBuffer out, size_t size);
     void RecordOutToSD();
     void FinishRecording();
@@ -131,10 +144,20 @@ class GrannyChordApp {
     void HandleButton1();
     void HandleButton2();
     void HandleButton1LongPress();
+    /* button 2 was held while turning the encoder or pressing button 1, so
+      its release doesn't also cycle the chord or scale */
+    bool button2_combo_ = false;
     void UpdateParams();
 
+    /* knob parameters - written by the UI loop, published whole and applied
+      by the audio callback at block start */
+    SynthParams ui_params_;
+    SynthParams applied_params_;
+    ParamSnapshot<SynthParams> params_;
+
     /* methods to update synth parameters */
     void UpdateSynthParams();
+    void ApplyParams();
     void UpdateKnob1SynthParams(float knob1_val, SynthMode mode);
     void UpdateKnob2SynthParams(float knob2_val, SynthMode mode);
 
@@ -142,6 +165,8 @@ class GrannyChordApp {
 
     void CycleChordPlaybackMode();
     void CycleChordScale();
+    void CycleChordInversion(int32_t increment);
+    void ToggleChordTuning();
     void ChangeChordKey();
     void ChangeChordSpawnPos();
 
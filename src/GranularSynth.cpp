@@ -1,121 +1,301 @@
 #include "GranularSynth.h"
+#include "StageProfiler.h"
+#include <algorithm>
 
 using namespace daisy;
+using namespace daisysp;
 
-/// @brief Initialise granular synth object and assign audio buffers
-/// @param left Left channel audio data buffer
-/// @param right Right channel audio data buffer
-/// @param audio_len Length of currently loaded audio file in samples
-void GranularSynth::Init(int16_t *left, int16_t *right, size_t audio_len){
-  left_buf_ = left;
-  right_buf_ = right;
+/// @brief Initialise granular synth object and assign the sample store
+/// @param store Store holding the loaded or recorded audio
+/// @param audio_len Length of currently loaded audio file in frames
+/// @param mips Mip-map levels of the audio, or nullptr to read the store only
+void GranularSynth::Init(const SampleStore *store, size_t audio_len, const SampleMipMap *mips){
+  store_ = store;
+  mips_ = mips;
   audio_len_ = audio_len;
-  for (Grain& grain: grains_){
-    grain.Init();
-  }
-  Grain::audio_len_ = audio_len;
-  Grain::left_buf_ = left;
-  Grain::right_buf_ = right;
+  grains_.Init(store, audio_len, mips);
+  scheduler_.Init(SAMPLE_RATE_FLOAT);
+  voices_.Init(&grains_, kFirstVoiceOwner, SAMPLE_RATE_FLOAT);
+  note_events_.Init();
+  chord_queue_.Init();
+  /* one level for linear interpolation, one per cloud grain shed, and the
+    last for no interpolation */
+  governor_.Init(SAMPLE_RATE_FLOAT, MAX_TARGET_GRAINS - kMinGovernedGrains + 2);
+  /* 50ms glides, settled within a sample */
+  size_smooth_.Init(SAMPLE_RATE_FLOAT, 0.05f, 0.0f, 1.0f);
+  pos_smooth_.Init(SAMPLE_RATE_FLOAT, 0.05f, 0.0f, 1.0f);
+  Reseed();
   InitParams();
 }
 
 void GranularSynth::Reset(size_t len){
   audio_len_ = len;
-  for (Grain& grain: grains_){
-    grain.Init();
-  }
+  grains_.Init(store_, len, mips_);
+  voices_.Init(&grains_, kFirstVoiceOwner, SAMPLE_RATE_FLOAT);
+  Reseed();
   InitParams();
 }
 
+/// @brief Sets the seed every random stream in the synth starts from, and restarts them
+/// @param seed Any value - the same seed, audio and controls give the same output
+void GranularSynth::SetSeed(uint32_t seed){
+  seed_ = seed;
+  Reseed();
+}
+
+/// @brief Restarts the jitter, cloud and voice streams, each on its own seed
+void GranularSynth::Reseed(){
+  rng_.Seed(seed_);
+  scheduler_.Seed(seed_ + 1);
+  voices_.Seed(seed_ + 2);
+}
+
 /// @brief  Set intial grain parameter values
 void GranularSynth::InitParams(){
   grain_size_ = 4800;
   spawn_pos_ = 0;
-  curr_active_count_ = 1;
+  size_smooth_.Reset(static_cast<float>(grain_size_));
+  pos_smooth_.Reset(static_cast<float>(spawn_pos_));
   pitch_ratio_ = 1.0f;
+  pan_ = 0.5f;
+  pan_jitter_ = 0.0f;
+  scheduler_.SetDensity(MIN_GRAIN_DENSITY);
+  voices_.SetDensity(MIN_GRAIN_DENSITY);
+  governor_.Reset();
+  /* leave room in the pool for chord grains, the cloud steals from itself past this */
+  ApplyQualityLevel(0);
 }
 
 /* these setters take a normalised value (ie float from 0-1) 
   from the user input knobs and convert this to the correct units */
 
+/// @brief Applies the synth parameters that differ from the last ones applied
+/// @param p Latest parameters
+/// @param prev Parameters applied before p
+void GranularSynth::SetParams(const SynthParams &p, const SynthParams &prev){
+  if (p.grain_size != prev.grain_size) SetGrainSize(p.grain_size);
+  if (p.spawn_pos != prev.spawn_pos) SetSpawnPos(p.spawn_pos);
+  if (p.pitch != prev.pitch) SetPitchRatio(p.pitch);
+  if (p.density != prev.density) SetDensity(p.density);
+  if (p.pan != prev.pan) SetPan(p.pan);
+  if (p.pan_width != prev.pan_width) SetPanJitter(p.pan_width);
+  if (p.window_taper != prev.window_taper) SetTukeyTaper(p.window_taper);
+}
+
 void GranularSynth::SetGrainSize(float knob_val){
-  float rnd = (RngFloat() * 0.1f) + knob_val;
+  float rnd = (rng_.Uniform() * 0.1f) + knob_val;
   knob_val = fclamp(rnd, 0.0f, 1.0f);
   // knob_val = fclamp(knob_val, 0.0f, 1.0f);
   float size_ms = fmap(knob_val, MIN_GRAIN_SIZE_MS, MAX_GRAIN_SIZE_MS, daisysp::Mapping::LOG);
-  grain_size_ = MsToSamples(size_ms);
+  size_smooth_.SetTarget(static_cast<float>(MsToSamples(size_ms)));
 }
 
 void GranularSynth::SetSpawnPos(float knob_val){
-  float rnd = (RngFloat() * 0.1f) + knob_val;
+  float rnd = (rng_.Uniform() * 0.1f) + knob_val;
   knob_val = fclamp(rnd, 0.0f, 1.0f);
   /* convert to samples */
-  spawn_pos_ = static_cast<size_t>(knob_val * static_cast<float>(audio_len_-1));
+  pos_smooth_.SetTarget(knob_val * static_cast<float>(audio_len_-1));
 }
 
 void GranularSynth::SetPitchRatio(float ratio){
-  float rnd = (RngFloat() * 0.1f) + ratio;
+  float rnd = (rng_.Uniform() * 0.1f) + ratio;
   ratio = fclamp(rnd, 0.0f, 1.0f);
   // ratio = fclamp(ratio, 0.0f, 1.0f);
   pitch_ratio_ = fmap(ratio, 0.5, 2, daisysp::Mapping::LINEAR);
 }
 
-void GranularSynth::SetTargetActiveGrains(float knob_val){
-  knob_val = round(fmap(knob_val, 1.0f, 10.0f));
-  target_active_count_ = (static_cast<size_t>(knob_val));
+/// @brief Sets the stereo position grains are centred on
+/// @param knob_val Normalised knob value, 0 is hard left and 1 hard right
+void GranularSynth::SetPan(float knob_val){
+  pan_ = fclamp(knob_val, 0.0f, 1.0f);
+}
+
+/// @brief Sets how widely grains are scattered around the pan position
+/// @param knob_val Normalised knob value, 0 keeps every grain on the pan position
+void GranularSynth::SetPanJitter(float knob_val){
+  pan_jitter_ = fclamp(knob_val, 0.0f, 1.0f);
+}
+
+/// @brief Picks the pan position for a new grain, scattered around pan_ by pan_jitter_
+/// @param u Uniform random value in [0, 1)
+float GranularSynth::NextPan(float u){
+  if (pan_jitter_ <= 0.0f) return pan_;
+  return fclamp(pan_ + (u - 0.5f) * pan_jitter_, 0.0f, 1.0f);
+}
+
+/// @brief Steps through the grain envelope shapes used for newly triggered grains
+/// @param increment Number of shapes to step by, can be negative
+void GranularSynth::CycleWindowShape(int32_t increment){
+  int32_t num_shapes = static_cast<int32_t>(NUM_WINDOW_SHAPES);
+  int32_t idx = (static_cast<int32_t>(window_shape_) + increment) % num_shapes;
+  if (idx < 0) idx += num_shapes;
+  window_shape_ = static_cast<WindowShape>(idx);
+}
+
+/// @brief Sets how many grains start per second
+/// @param knob_val Normalised knob value, mapped logarithmically onto the density range
+void GranularSynth::SetDensity(float knob_val){
+  float density = fmap(knob_val, MIN_GRAIN_DENSITY, MAX_GRAIN_DENSITY, daisysp::Mapping::LOG);
+  scheduler_.SetDensity(density);
+  voices_.SetDensity(density);
+}
+
+/// @brief Sets how onsets are spaced for the cloud and the MIDI voices
+void GranularSynth::SetSchedulerMode(SchedulerMode mode){
+  scheduler_.SetMode(mode);
+  voices_.SetSchedulerMode(mode);
+}
+
+/// @brief Starts a new grain. Once the grain budget is used up an existing grain
+///        is stolen, see GrainPoolImpl::SetStealPolicy
+/// @param jitter The grain's row of jitter_
+void GranularSynth::TriggerGrain(const float *jitter){
+  size_t pos = JitterPos(spawn_pos_, jitter[kJitterPos]);
+  size_t sz = JitterSize(jitter[kJitterSize]);
+  float pitch = fclamp(pitch_ratio_ + (pitch_ratio_*jitter[kJitterPitch]*0.2f), 0.5f, 2.0f);
+  grains_.Trigger(pos,sz,pitch,window_shape_,kCloudOwner,NextPan(jitter[kJitterPan]));
+}
+
+/// @brief Starts a grain for a MIDI voice, at the voice's pitch and level. Past the
+///        voice's grain budget the voice steals from itself
+/// @param jitter The grain's row of jitter_
+void GranularSynth::TriggerVoiceGrain(size_t voice, const float *jitter){
+  size_t pos = JitterPos(voices_.SpawnPos(voice), jitter[kJitterPos]);
+  size_t sz = JitterSize(jitter[kJitterSize]);
+  grains_.Trigger(pos, sz, voices_.Pitch(voice), window_shape_, voices_.Owner(voice),
+                  NextPan(jitter[kJitterPan]), voices_.Gain(voice));
+}
+
+/// @brief Scatters a grain's spawn position up to 20% past pos
+/// @param u Uniform random value in [0, 1)
+size_t GranularSynth::JitterPos(size_t pos, float u){
+  pos = pos + static_cast<size_t>((static_cast<float>(pos)*u)*0.2f);
+  return intclamp(pos, 0.0f, audio_len_);
+}
+
+/// @brief Grain size scattered up to 20% above the set size
+/// @param u Uniform random value in [0, 1)
+size_t GranularSynth::JitterSize(float u){
+  size_t sz = grain_size_ + static_cast<size_t>((static_cast<float>(grain_size_)*u)*0.2f);
+  return intclamp(sz, MIN_GRAIN_SIZE_SAMPLES, MAX_GRAIN_SIZE_SAMPLES);
 }
 
-/* this increases the number of active grains more smoothly - had dropout issues without */
-void GranularSynth::UpdateActiveGrains(){
-  if (curr_active_count_< target_active_count_){
-    smooth_count ++;
-    if (smooth_count==48000){
-      smooth_count = 0;
-      curr_active_count_++;
+/// @brief Processes and sums audio of active grains for a single sample
+/// @return Summed stereo output of all active grains
+Sample GranularSynth::ProcessGrains(){
+  Sample sample = {0.0f, 0.0f};
+  ProcessBlock(&sample.left, &sample.right, 1);
+  return sample;
+}
+
+/// @brief Renders the grains for a block, starting new grains on the exact
+///        sample the scheduler places them at
+/// @param out_left Left channel output buffer
+/// @param out_right Right channel output buffer
+/// @param size Number of samples to process in this call
+void GranularSynth::ProcessBlock(float *out_left, float *out_right, size_t size){
+  memset(out_left, 0, size*sizeof(float));
+  memset(out_right, 0, size*sizeof(float));
+  UpdateSmoothing(size);
+  size_t onsets;
+  {
+    PROFILE_STAGE(GrainTrigger);
+    HandleNoteEvents();
+    onsets = scheduler_.NextBlock(size, onset_offsets_, MAX_ONSETS_PER_BLOCK);
+    for (size_t i=0; i<onsets; i++){
+      onsets_[i] = {onset_offsets_[i], VoiceAllocator::kNoVoice};
     }
+    onsets = voices_.NextBlock(size, onsets_, onsets, MAX_ONSETS_PER_BLOCK);
+    rng_.FillUniform(jitter_, onsets * kJitterValues);
   }
+  /* render up to each onset, start the grain, then carry on from there */
+  size_t start = 0;
+  for (size_t i=0; i<onsets; i++){
+    size_t offset = onsets_[i].offset;
+    const float *jitter = &jitter_[i * kJitterValues];
+    {
+      PROFILE_STAGE(GrainRender);
+      grains_.ProcessBlock(out_left+start, out_right+start, offset-start);
+    }
+    PROFILE_STAGE(GrainTrigger);
+    if (onsets_[i].voice == VoiceAllocator::kNoVoice) TriggerGrain(jitter);
+    else TriggerVoiceGrain(onsets_[i].voice, jitter);
+    start = offset;
+  }
+  PROFILE_STAGE(GrainRender);
+  grains_.ProcessBlock(out_left+start, out_right+start, size-start);
 }
 
-size_t GranularSynth::GetActiveGrains(){
-  return curr_active_count_;
-}
-
-/// @brief Triggers new grains 
-void GranularSynth::TriggerGrain(){
-  size_t count = 0;
-  for(Grain& grain:grains_){
-    if (grain.is_active_) { count++; }
-    else if (count<curr_active_count_){
-      size_t pos = spawn_pos_ + static_cast<size_t>((static_cast<float>(spawn_pos_)*RngFloat())*0.2f);
-      pos = intclamp(pos, 0.0f, audio_len_);
-      size_t sz = grain_size_ + static_cast<size_t>((static_cast<float>(grain_size_)*RngFloat())*0.2f);
-      sz = intclamp(sz, MIN_GRAIN_SIZE_SAMPLES, MAX_GRAIN_SIZE_SAMPLES);
-      float pitch = fclamp(pitch_ratio_ + (pitch_ratio_*RngFloat()*0.2f), 0.5f, 2.0f);
-      grain.Trigger(pos,sz,pitch);
-      count++;
-      break;
-    }
+/// @brief Sets the interpolation grains are read with. The load governor may
+///        fall back to a cheaper one while the CPU is overloaded
+void GranularSynth::SetInterpolation(GrainInterp interp){
+  interp_ = interp;
+  ApplyQualityLevel(governor_.Level());
+}
+
+/// @brief Passes the load of the last block to the governor and sheds or
+///        restores quality when it changes level. Call from the audio callback
+/// @param load Load as a fraction of the block time, eg CpuLoadMeter::GetAvgCpuLoad
+/// @param block_size Samples in the block
+void GranularSynth::GovernLoad(float load, size_t block_size){
+  if (governor_.Update(load, block_size)){
+    ApplyQualityLevel(governor_.Level());
   }
 }
 
-/// @brief Processes and sums audio of active grains, then mixes to output buffers
-/// @param out_left Pointer to left channel audio output buffer
-/// @param out_right Pointer to right channel audio output buffer
-/// @param size Number of samples to process in this call 
-Sample GranularSynth::ProcessGrains(){
-  UpdateActiveGrains();
-  sample_.left=0.0f, sample_.right=0.0f;
-  TriggerGrain();
-  for (Grain& grain:grains_){
-    if (grain.is_active_){
-      sample_ = grain.Process(sample_);
-    }
+/// @brief Sets the cloud grain limit and interpolation for a governor quality level.
+///        Level 1 swaps Hermite for linear interpolation, each level after sheds a
+///        cloud grain down to kMinGovernedGrains, and the last drops interpolation
+void GranularSynth::ApplyQualityLevel(size_t level){
+  GrainInterp interp = interp_;
+  if (level >= 1 && interp > GrainInterp::Linear) interp = GrainInterp::Linear;
+  if (level >= governor_.MaxLevel() && level > 0) interp = GrainInterp::None;
+  grains_.SetInterpolation(interp);
+
+  size_t shed = level > 1 ? level - 1 : 0;
+  grain_limit_ = MAX_TARGET_GRAINS - std::min(shed, MAX_TARGET_GRAINS - kMinGovernedGrains);
+  grains_.SetOwnerLimit(kCloudOwner, grain_limit_);
+  grains_.Shed(kCloudOwner);
+}
+
+/// @brief Advances the grain size and spawn position glides by one block
+void GranularSynth::UpdateSmoothing(size_t size){
+  if (size_smooth_.Process(size)) grain_size_ = static_cast<size_t>(size_smooth_.Value());
+  if (pos_smooth_.Process(size)) spawn_pos_ = static_cast<size_t>(pos_smooth_.Value());
+}
+
+/// @brief Queues a MIDI note on for the audio callback
+/// @param note MIDI note number
+/// @param velocity MIDI velocity, 0 is treated as a note off
+/// @return False if the queue is full and the note was dropped
+bool GranularSynth::PostNoteOn(uint8_t note, uint8_t velocity){
+  if (!note_events_.writable()) return false;
+  note_events_.Overwrite({note, velocity});
+  return true;
+}
+
+/// @brief Queues a MIDI note off for the audio callback
+/// @return False if the queue is full and the note was dropped
+bool GranularSynth::PostNoteOff(uint8_t note){
+  return PostNoteOn(note, 0);
+}
+
+/// @brief Applies the notes posted since the last block to the voices
+void GranularSynth::HandleNoteEvents(){
+  while (note_events_.readable()){
+    NoteEvent event = note_events_.ImmediateRead();
+    if (event.velocity > 0) voices_.NoteOn(event.note, event.velocity, spawn_pos_);
+    else voices_.NoteOff(event.note);
   }
-  return sample_;
 }
 
-void GranularSynth::EnqueueChord(std::vector<float> ratios){
-  chord_queue_.push(ratios);
+/// @brief Queues a chord to play once the current one has finished. Call from the UI loop
+/// @param chord Pitch ratio of each note
+/// @return False if the queue is full and the chord was dropped
+bool GranularSynth::EnqueueChord(const ChordRatios &chord){
+  if (!chord_queue_.writable()) return false;
+  chord_queue_.Overwrite(chord);
+  return true;
 }
 
 bool GranularSynth::ChordActive(){
@@ -123,41 +303,46 @@ bool GranularSynth::ChordActive(){
 }
 
 bool GranularSynth::ChordQueueEmpty(){
-  return chord_queue_.empty();
+  return chord_queue_.isEmpty();
 }
 
 void GranularSynth::TriggerChord(){
-  if (chord_queue_.empty()) return;
-  chord_ratios_ = chord_queue_.front();
-  chord_queue_.pop();
+  if (chord_queue_.isEmpty()) return;
+  PROFILE_STAGE(GrainTrigger);
+  ChordRatios chord = chord_queue_.ImmediateRead();
   chord_active_ = true;
-  chord_grain_lengths_.clear();
-  max_chord_length_ = 0;
-  chord_sample_count_ = 0;
-  for (size_t i=0; i<chord_ratios_.size(); i++){
-    size_t grain_len = static_cast<size_t>(grain_size_/chord_ratios_[i]);
-    chord_grain_lengths_.push_back(grain_len);
-    max_chord_length_ = std::max(max_chord_length_, grain_len);
-    grains_[i].Trigger(spawn_pos_, grain_size_, chord_ratios_[i]);
+  /* each chord grain lasts grain_size_/ratio samples, so the grains finish
+    on their own at their chord lengths */
+  for (size_t i=0; i<chord.count; i++){
+    grains_.Trigger(spawn_pos_, grain_size_, chord.ratios[i], window_shape_, kChordOwner,
+                    NextPan(rng_.Uniform()));
   }
 }
 
+/// @brief Processes chord grains for a single sample
+/// @return Summed stereo output of the chord grains
 Sample GranularSynth::ProcessChord(){
-  sample_ = {0.0f, 0.0f};
-  if (chord_active_){
-    bool grains_finished = true;
-    for (size_t i =0; i<chord_ratios_.size();i++){
-      if (chord_sample_count_ < chord_grain_lengths_[i]){
-        sample_ = grains_[i].Process(sample_);
-        grains_finished = false;
-      }
-    }
-    chord_sample_count_++;
-    if (grains_finished || (chord_sample_count_ >= max_chord_length_)){
-      chord_active_ =false;
-    }
-  }
-  return sample_;
+  Sample sample = {0.0f, 0.0f};
+  ProcessChordBlock(&sample.left, &sample.right, 1);
+  return sample;
 }
 
-
+/// @brief Renders the grains of the current chord across the block and sums into 
+///        the output buffers. The chord ends once all of its grains have finished.
+///        No cloud or voice grains start, but those already playing are rendered
+///        too, so they finish their envelopes rather than freezing mid-grain
+/// @param out_left Left channel output buffer
+/// @param out_right Right channel output buffer
+/// @param size Number of samples to process in this call
+void GranularSynth::ProcessChordBlock(float *out_left, float *out_right, size_t size){
+  memset(out_left, 0, size*sizeof(float));
+  memset(out_right, 0, size*sizeof(float));
+  UpdateSmoothing(size);
+  /* note offs still arrive in chord mode, for notes held from the cloud */
+  HandleNoteEvents();
+  PROFILE_STAGE(GrainRender);
+  grains_.ProcessBlock(out_left, out_right, size);
+  if (chord_active_ && grains_.OwnerCount(kChordOwner) == 0){
+    chord_active_ = false;
+  }
+}
@@ -1,67 +1,144 @@
 #pragma once
 
-#include "Grain.h"
+#include "GrainPool.h"
+#include "GrainScheduler.h"
+#include "VoiceAllocator.h"
+#include "LoadGovernor.h"
+#include "ParamSmoother.h"
+#include "BlockRng.h"
+#include "SynthParams.h"
+#include "sample.h"
 #include "daisy_pod.h"
+#include "daisysp.h"
 #include "debug_print.h"
 #include "ChordMode.h"
-#include <vector>
-#include <queue>
+#include "util/ringbuffer.h"
 
 class GranularSynth{
   public:
-    GranularSynth(DaisyPod& pod) 
-      : pod_(pod), left_buf_(nullptr), right_buf_(nullptr), audio_len_(0),
-        grains_(){}
+    GranularSynth(DaisyPod& pod, GrainSlabMemory &slab_mem)
+      : pod_(pod), store_(nullptr), mips_(nullptr), audio_len_(0), grains_(slab_mem), seed_(DEFAULT_RNG_SEED){}
 
-    void Init(int16_t *left, int16_t *right, size_t audio_len);
+    void Init(const SampleStore *store, size_t audio_len, const SampleMipMap *mips=nullptr);
     void Reset(size_t len);
     void InitParams();
-    void TriggerGrain();
+    void SetSeed(uint32_t seed);
     Sample ProcessGrains();
+    void ProcessBlock(float *out_left, float *out_right, size_t size);
 
-    void EnqueueChord(std::vector<float> ratios);
+    /* MIDI notes, posted from the main loop and played from the next block */
+    bool PostNoteOn(uint8_t note, uint8_t velocity);
+    bool PostNoteOff(uint8_t note);
+    void SetReleaseTime(float seconds) { voices_.SetReleaseTime(seconds); }
+    size_t GetHeldVoices() { return voices_.HeldVoices(); }
+
+    /* CPU load governor, fed the callback's load after every block */
+    void GovernLoad(float load, size_t block_size);
+    void SetLoadCeiling(float ceiling) { governor_.SetCeiling(ceiling); }
+    const LoadGovernor& GetGovernor() { return governor_; }
+    size_t GetGrainLimit() { return grain_limit_; }
+
+    bool EnqueueChord(const ChordRatios &chord);
     bool ChordActive();
     bool ChordQueueEmpty();
     
     Sample ProcessChord();
+    void ProcessChordBlock(float *out_left, float *out_right, size_t size);
     void TriggerChord();
   
+    void SetParams(const SynthParams &p, const SynthParams &prev);
     void SetGrainSize(float knob_val);
     void SetSpawnPos(float knob_val);
-    void SetTargetActiveGrains(float knob_val);
-    void UpdateActiveGrains();
-    size_t GetActiveGrains();
+    void SetDensity(float knob_val);
+    void SetSchedulerMode(SchedulerMode mode);
+    size_t GetActiveGrains() { return grains_.ActiveCount(); }
     void SetPitchRatio(float ratio);
+    void SetPan(float knob_val);
+    void SetPanJitter(float knob_val);
+    void SetWindowShape(WindowShape shape) { window_shape_ = shape; }
+    void CycleWindowShape(int32_t increment);
+    /* taper of Tukey grains, 0 (rectangle) to 1 (Hann) - from the audio callback only */
+    void SetTukeyTaper(float taper) { grains_.SetTukeyTaper(taper); }
+    void SetInterpolation(GrainInterp interp);
+    void SetStealPolicy(StealPolicy policy) { grains_.SetStealPolicy(policy); }
+    size_t GetStealCount() { return grains_.StealCount(); }
+    /* grain cache hits and misses since Init, for sizing the slabs */
+    const GrainCache::Stats& GetCacheStats() { return grains_.CacheStats(); }
 
     size_t GetSize(){ return grain_size_; }
     float GetPitch(){ return pitch_ratio_; }
+    float GetPan(){ return pan_; }
+    float GetPanJitter(){ return pan_jitter_; }
+    WindowShape GetWindowShape(){ return window_shape_; }
     size_t GetPos() { return spawn_pos_; }
-    size_t GetCount(){ return curr_active_count_; }
+    float GetDensity(){ return scheduler_.GetDensity(); }
 
   private:
     DaisyPod& pod_;
-    /* pointers to SDRAM audio buffers */
-    int16_t *left_buf_;
-    int16_t *right_buf_;
+    /* SDRAM audio the grains read from */
+    const SampleStore *store_;
+    /* decimated copies read by pitched up grains */
+    const SampleMipMap *mips_;
     /* length of audio in samples */
     size_t audio_len_;
-    Grain grains_[MAX_GRAINS];
-    Sample sample_;
+    GrainPool<MAX_GRAINS> grains_;
+    GrainScheduler scheduler_;
+    VoiceAllocator voices_;
+    LoadGovernor governor_;
+    /* cloud grain limit and interpolation set by the governor's quality level */
+    size_t grain_limit_ = MAX_TARGET_GRAINS;
+    GrainInterp interp_ = GrainInterp::Hermite;
+    uint16_t onset_offsets_[MAX_ONSETS_PER_BLOCK];
+    GrainOnset onsets_[MAX_ONSETS_PER_BLOCK];
+    /* random streams are restarted from the seed on Init and Reset, so the same
+      audio and controls always render the same */
+    uint32_t seed_;
+    BlockRng rng_;
+    /* uniforms scattering each grain started in a block, drawn for the whole
+      block at once - onset i uses the row starting at i * kJitterValues */
+    enum JitterValue { kJitterPos, kJitterSize, kJitterPitch, kJitterPan, kJitterValues };
+    float jitter_[MAX_ONSETS_PER_BLOCK * kJitterValues];
+    /* note on (velocity > 0) or off from the main loop - single producer,
+      single consumer, so it needs no locking */
+    struct NoteEvent {
+      uint8_t note;
+      uint8_t velocity;
+    };
+    RingBuffer<NoteEvent, 32> note_events_;
 
     /* parameters affecting audio output */
     size_t grain_size_;
     size_t spawn_pos_;
-    size_t curr_active_count_;
-    size_t target_active_count_;
+    /* the size and position knobs glide grain_size_ and spawn_pos_ to their
+      new values, advanced once per block */
+    OnePoleSmoother size_smooth_;
+    OnePoleSmoother pos_smooth_;
     float pitch_ratio_;
+    /* stereo position grains are centred on (0-1), and how far either side
+      of it each grain is scattered - 1 spreads grains across the whole field */
+    float pan_;
+    float pan_jitter_;
+    WindowShape window_shape_ = WindowShape::Hann;
 
-    std::vector<float> chord_ratios_;
+    /* owner tags the pool counts cloud and chord grains under */
+    static constexpr uint8_t kCloudOwner = 0;
+    static constexpr uint8_t kChordOwner = 1;
+    /* voice i plays its grains under owner kFirstVoiceOwner + i */
+    static constexpr uint8_t kFirstVoiceOwner = 2;
+    void Reseed();
+    float NextPan(float u);
+    size_t JitterPos(size_t pos, float u);
+    size_t JitterSize(float u);
+    void TriggerGrain(const float *jitter);
+    void TriggerVoiceGrain(size_t voice, const float *jitter);
+    void HandleNoteEvents();
+    void ApplyQualityLevel(size_t level);
+    void UpdateSmoothing(size_t size);
+    /* fewest cloud grains the governor sheds down to */
+    static constexpr size_t kMinGovernedGrains = 2;
     bool chord_active_ = false;
-    std::queue<std::vector<float>> chord_queue_;
-    std::vector<size_t>chord_grain_lengths_;
-    size_t max_chord_length_;
-    size_t chord_sample_count_;
-
-    int smooth_count = 0;
+    /* chords from the UI loop, waiting to play - single producer, single consumer.
+      ChordRatios holds its ratios inline, so queueing a chord never allocates */
+    RingBuffer<ChordRatios, CHORD_QUEUE_SIZE> chord_queue_;
 
 };
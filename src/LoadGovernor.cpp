@@ -0,0 +1,71 @@
+#include "LoadGovernor.h"
+
+/// @brief Initialise the governor at full quality with an 80% ceiling
+/// @param sample_rate Audio sample rate in Hz
+/// @param max_level Highest quality level the caller can shed to
+void LoadGovernor::Init(float sample_rate, size_t max_level){
+  sample_rate_ = sample_rate;
+  ceiling_ = 0.8f;
+  hysteresis_ = 0.1f;
+  /* react within 20ms, wait half a second before giving quality back */
+  shed_hold_ = 0.02f * sample_rate;
+  recover_hold_ = 0.5f * sample_rate;
+  /* a 10Hz CpuLoadMeter average takes about 100ms to show a level change */
+  settle_hold_ = 0.1f * sample_rate;
+  max_level_ = max_level;
+  Reset();
+}
+
+/// @brief Returns to full quality and clears the load metrics
+void LoadGovernor::Reset(){
+  over_ = 0.0f;
+  under_ = 0.0f;
+  settle_ = 0.0f;
+  level_ = 0;
+  load_ = 0.0f;
+  peak_load_ = 0.0f;
+  shed_count_ = 0;
+}
+
+/// @brief Feeds in the load of the last block and moves the quality level
+/// @param load Load of the audio callback as a fraction of the block time, eg
+///        the CpuLoadMeter average
+/// @param block_size Samples in the block the load was measured over
+/// @return True if the level changed
+bool LoadGovernor::Update(float load, size_t block_size){
+  load_ = load;
+  if (load > peak_load_) peak_load_ = load;
+  const float samples = static_cast<float>(block_size);
+  /* the load still reflects the level before the last change */
+  if (settle_ > 0.0f){
+    settle_ -= samples;
+    return false;
+  }
+  if (load > ceiling_){
+    over_ += samples;
+    under_ = 0.0f;
+    if (over_ >= shed_hold_ && level_ < max_level_){
+      level_++;
+      shed_count_++;
+      over_ = 0.0f;
+      settle_ = settle_hold_;
+      return true;
+    }
+  }
+  else if (load < ceiling_ - hysteresis_){
+    under_ += samples;
+    over_ = 0.0f;
+    if (under_ >= recover_hold_ && level_ > 0){
+      level_--;
+      under_ = 0.0f;
+      settle_ = settle_hold_;
+      return true;
+    }
+  }
+  else {
+    /* inside the hysteresis band - hold the current level */
+    over_ = 0.0f;
+    under_ = 0.0f;
+  }
+  return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "constants_utils.h"
+
+/* Closed-loop CPU load governor. Fed the measured load of each audio block,
+  it steps a quality level up while the load sits above the ceiling and back
+  down once it has been below the ceiling minus the hysteresis for a while.
+  Level 0 is full quality - what each level sheds is up to the caller (see
+  GranularSynth::ApplyQualityLevel). Recovery waits longer than shedding so
+  the level doesn't flap around the ceiling.
+  A smoothed load (eg the CpuLoadMeter average) lags a level change, so
+  after each change the governor waits for the settle time before it moves
+  again - otherwise one overload would shed level after level before the
+  average caught up with the first */
+class LoadGovernor {
+  public:
+    LoadGovernor() : max_level_(0), level_(0) {}
+
+    void Init(float sample_rate, size_t max_level);
+    void Reset();
+    bool Update(float load, size_t block_size);
+
+    /// @brief Sets the load the governor holds the audio callback under
+    /// @param ceiling Fraction of the block time (0-1), eg 0.8
+    void SetCeiling(float ceiling) { ceiling_ = ceiling; }
+    /// @brief Sets how far below the ceiling the load must fall before quality is restored
+    void SetHysteresis(float hysteresis) { hysteresis_ = hysteresis; }
+    /// @brief Sets how long the load is ignored after a level change
+    /// @param seconds At least the time the load fed to Update takes to show a change
+    void SetSettleTime(float seconds) { settle_hold_ = seconds * sample_rate_; }
+
+    size_t Level() const { return level_; }
+    size_t MaxLevel() const { return max_level_; }
+    float Ceiling() const { return ceiling_; }
+    /* load passed to the last Update */
+    float Load() const { return load_; }
+    /* highest load seen since Reset */
+    float PeakLoad() const { return peak_load_; }
+    /* times quality has been lowered since Reset */
+    size_t ShedCount() const { return shed_count_; }
+
+  private:
+    float sample_rate_;
+    float ceiling_;
+    float hysteresis_;
+    /* samples the load must stay over / under its threshold before the level moves */
+    float shed_hold_;
+    float recover_hold_;
+    float settle_hold_;
+    float over_;
+    float under_;
+    /* samples left to wait after the last level change */
+    float settle_;
+    size_t max_level_;
+    size_t level_;
+    float load_;
+    float peak_load_;
+    size_t shed_count_;
+};
@@ -0,0 +1,77 @@
+#include "ParamSmoother.h"
+
+/// @brief Initialise the ramp, settled on a value
+/// @param sample_rate Audio sample rate in Hz
+/// @param ramp_time Time taken to reach each new target, in seconds
+/// @param value Starting value
+void LinearRamp::Init(float sample_rate, float ramp_time, float value){
+  ramp_samples_ = ramp_time * sample_rate;
+  if (ramp_samples_ < 1.0f) ramp_samples_ = 1.0f;
+  Reset(value);
+}
+
+/// @brief Jumps straight to a value with no ramp
+void LinearRamp::Reset(float value){
+  value_ = target_ = value;
+  step_ = 0.0f;
+  remaining_ = 0.0f;
+}
+
+/// @brief Starts a ramp from the current value to target
+void LinearRamp::SetTarget(float target){
+  if (target == target_) return;
+  target_ = target;
+  remaining_ = ramp_samples_;
+  step_ = (target_ - value_) / ramp_samples_;
+}
+
+/// @brief Advances the ramp by one block
+/// @param block_size Samples in the block
+/// @return True if the value changed
+bool LinearRamp::Process(size_t block_size){
+  if (remaining_ <= 0.0f) return false;
+  const float samples = static_cast<float>(block_size);
+  if (samples >= remaining_){
+    value_ = target_;
+    remaining_ = 0.0f;
+  }
+  else {
+    value_ += step_ * samples;
+    remaining_ -= samples;
+  }
+  return true;
+}
+
+/// @brief Initialise the smoother, settled on a value
+/// @param sample_rate Audio sample rate in Hz
+/// @param time_constant Time to cover 63% of a change, in seconds
+/// @param value Starting value
+/// @param tolerance Distance from the target at which the value snaps to it
+void OnePoleSmoother::Init(float sample_rate, float time_constant, float value, float tolerance){
+  time_samples_ = time_constant * sample_rate;
+  if (time_samples_ < 1.0f) time_samples_ = 1.0f;
+  tolerance_ = tolerance;
+  coef_block_ = 0;
+  Reset(value);
+}
+
+/// @brief Jumps straight to a value
+void OnePoleSmoother::Reset(float value){
+  value_ = target_ = value;
+}
+
+/// @brief Advances the smoother by one block
+/// @param block_size Samples in the block
+/// @return True if the value changed
+bool OnePoleSmoother::Process(size_t block_size){
+  if (value_ == target_) return false;
+  if (block_size != coef_block_){
+    /* the one-pole coefficient for a whole block at once - only worked out
+      again if the block size changes */
+    coef_ = 1.0f - expf(-static_cast<float>(block_size) / time_samples_);
+    coef_block_ = block_size;
+  }
+  value_ += coef_ * (target_ - value_);
+  if (fabsf(target_ - value_) <= tolerance_) value_ = target_;
+  return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "constants_utils.h"
+
+/* Block-rate parameter smoothing. A control sets a smoother's target when it
+  moves and the smoothed value advances once per audio block, so anything
+  expensive derived from it (eg filter coefficients) is recomputed at most
+  once a block - and not at all once the value has settled, as Process only
+  reports a change while the value is still moving */
+
+/* moves to each new target in a straight line over a fixed time */
+class LinearRamp {
+  public:
+    LinearRamp() : value_(0.0f), target_(0.0f), step_(0.0f), ramp_samples_(1.0f), remaining_(0.0f) {}
+
+    void Init(float sample_rate, float ramp_time, float value);
+    void Reset(float value);
+    void SetTarget(float target);
+    bool Process(size_t block_size);
+
+    float Value() const { return value_; }
+    float Target() const { return target_; }
+
+  private:
+    float value_;
+    float target_;
+    /* change per sample */
+    float step_;
+    float ramp_samples_;
+    /* samples until the target is reached */
+    float remaining_;
+};
+
+/* exponential approach to the target, snapping to it once within tolerance */
+class OnePoleSmoother {
+  public:
+    OnePoleSmoother() : value_(0.0f), target_(0.0f), tolerance_(0.0f), time_samples_(1.0f),
+                        coef_(1.0f), coef_block_(0) {}
+
+    void Init(float sample_rate, float time_constant, float value, float tolerance);
+    void Reset(float value);
+    void SetTarget(float target) { target_ = target; }
+    bool Process(size_t block_size);
+
+    float Value() const { return value_; }
+    float Target() const { return target_; }
+
+  private:
+    float value_;
+    float target_;
+    float tolerance_;
+    /* time constant in samples */
+    float time_samples_;
+    /* per-block coefficient, cached for the block size it was worked out for */
+    float coef_;
+    size_t coef_block_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+/* Seqlock handing a whole parameter struct from the UI loop to the audio
+  callback. The writer never waits and the reader never sees a torn struct:
+  the sequence count is odd while a write is in progress, and a read that
+  overlaps a write is thrown away - the callback keeps its current values
+  and picks the snapshot up next block. One writer, one reader */
+template <typename T>
+class ParamSnapshot {
+  public:
+    ParamSnapshot() : seq_(0), last_read_(0) {}
+
+    /// @brief Publishes a new snapshot. Call from the UI loop only
+    void Publish(const T &params){
+      uint32_t seq = seq_.load(std::memory_order_relaxed);
+      seq_.store(seq + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      data_ = params;
+      seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /// @brief Copies out the latest snapshot if it hasn't been read yet. Call from
+    ///        the audio callback only
+    /// @param params Filled with the snapshot, untouched if this returns false
+    /// @return True if a new, complete snapshot was read
+    bool Read(T &params){
+      uint32_t seq = seq_.load(std::memory_order_acquire);
+      if ((seq & 1) || seq == last_read_) return false;
+      T copy = data_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) != seq) return false;
+      params = copy;
+      last_read_ = seq;
+      return true;
+    }
+
+  private:
+    std::atomic<uint32_t> seq_;
+    uint32_t last_read_;
+    T data_;
+};
@@ -0,0 +1,86 @@
+#include "SampleMipMap.h"
+#include <algorithm>
+
+/// @brief Assigns the buffer the decimated levels are built in and designs the
+///        half-band filter. Uses the precise libm functions as this only runs at startup
+/// @param buf Mip-map buffer, usually in SDRAM
+/// @param buf_size Size of the buffer in int16 samples - 3/4 of the sample store
+///        buffer holds both levels for the longest audio
+void SampleMipMap::Init(int16_t *buf, size_t buf_size){
+  buf_ = buf;
+  buf_size_ = buf_size;
+  num_levels_ = 1;
+  /* Blackman windowed sinc with its cutoff at half Nyquist, see
+    https://www.dspguide.com/ch16/2.htm. Even taps of a half-band filter are 0 */
+  const float len = static_cast<float>(2 * kHalfTaps + 2);
+  float sum = 0.5f;
+  for (size_t i=0; i<kOddTaps; i++){
+    float n = static_cast<float>(2 * i + 1);
+    float sinc = sinf(0.5f * M_PI * n) / (M_PI * n);
+    float x = (n + static_cast<float>(kHalfTaps + 1)) / len;
+    float window = 0.42f - 0.5f * cosf(2.0f * M_PI * x) + 0.08f * cosf(4.0f * M_PI * x);
+    odd_taps_[i] = sinc * window;
+    sum += 2.0f * odd_taps_[i];
+  }
+  /* normalise to unity gain at DC */
+  for (size_t i=0; i<kOddTaps; i++){
+    odd_taps_[i] *= 1.0f / sum;
+  }
+  centre_tap_ = 0.5f / sum;
+}
+
+/// @brief Builds the 2x and 4x decimated levels of the loaded audio
+/// @param store Store holding the audio, becomes level 0
+/// @param len Length of the audio in frames
+/// @return False if the buffer is too small, leaving only level 0
+bool SampleMipMap::Build(const SampleStore *store, size_t len){
+  base_ = store;
+  num_levels_ = 1;
+  if (!buf_) return false;
+  const size_t channels = store->Channels();
+  const size_t len1 = len / 2;
+  const size_t len2 = len1 / 2;
+  /* the filter wraps around the audio, so it needs more frames than taps */
+  if ((len1 + len2) * channels > buf_size_ || len2 < kHalfTaps) return false;
+
+  levels_[0].Init(buf_, len1 * channels);
+  levels_[0].SetChannels(channels);
+  levels_[0].SetLength(len1);
+  levels_[1].Init(buf_ + len1 * channels, len2 * channels);
+  levels_[1].SetChannels(channels);
+  levels_[1].SetLength(len2);
+
+  Decimate(*store, len, levels_[0], len1);
+  Decimate(levels_[0], len1, levels_[1], len2);
+  num_levels_ = kNumLevels;
+  return true;
+}
+
+/* rounds and saturates a filter output back to int16 */
+static inline int16_t ToSample(float x){
+  return static_cast<int16_t>(std::min(std::max(roundf(x), -32768.0f), 32767.0f));
+}
+
+/// @brief Lowpasses src with the half-band filter and keeps every other frame.
+///        The audio is treated as a loop, as grains wrap around it
+void SampleMipMap::Decimate(const SampleStore &src, size_t src_len, SampleStore &dst, size_t dst_len) const {
+  for (size_t m=0; m<dst_len; m++){
+    const size_t centre = 2 * m;
+    int16_t l, r;
+    src.Read(centre, l, r);
+    float acc_l = centre_tap_ * static_cast<float>(l);
+    float acc_r = centre_tap_ * static_cast<float>(r);
+    for (size_t i=0; i<kOddTaps; i++){
+      const size_t offset = 2 * i + 1;
+      size_t before = centre >= offset ? centre - offset : centre + src_len - offset;
+      size_t after = centre + offset;
+      if (after >= src_len) after -= src_len;
+      int16_t lb, rb, la, ra;
+      src.Read(before, lb, rb);
+      src.Read(after, la, ra);
+      acc_l += odd_taps_[i] * static_cast<float>(lb + la);
+      acc_r += odd_taps_[i] * static_cast<float>(rb + ra);
+    }
+    dst.Write(m, ToSample(acc_l), ToSample(acc_r));
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "SampleStore.h"
+
+/* Mip-map pyramid of a sample store: copies decimated by 2 and by 4 through
+  a half-band lowpass, built once when audio is loaded. A grain pitched up
+  reads from the level decimated by the octaves it is raised, rounded up -
+  level 1 for pitches over 1x up to 2x - so pitch-up doesn't alias and needs
+  no filtering per grain. Level 0 is the store
+  itself; levels 1 and 2 live one after the other in the mip-map buffer */
+class SampleMipMap {
+  public:
+    static constexpr size_t kNumLevels = 3;
+
+    SampleMipMap() : centre_tap_(0.5f), buf_(nullptr), buf_size_(0), base_(nullptr), num_levels_(1) {}
+
+    void Init(int16_t *buf, size_t buf_size);
+    bool Build(const SampleStore *store, size_t len);
+    void Clear() { num_levels_ = 1; }
+
+    /* levels available, including level 0 */
+    size_t Levels() const { return num_levels_; }
+    const SampleStore* Level(size_t level) const { return level ? &levels_[level-1] : base_; }
+
+  private:
+    void Decimate(const SampleStore &src, size_t src_len, SampleStore &dst, size_t dst_len) const;
+
+    /* 31 tap half-band lowpass. Only the centre tap and the odd taps are
+      non-zero, and it is symmetric, so only the odd taps on one side are kept */
+    static constexpr size_t kHalfTaps = 15;
+    static constexpr size_t kOddTaps = (kHalfTaps + 1) / 2;
+    float centre_tap_;
+    float odd_taps_[kOddTaps];
+
+    int16_t *buf_;
+    size_t buf_size_;
+    const SampleStore *base_;
+    SampleStore levels_[kNumLevels - 1];
+    size_t num_levels_;
+};
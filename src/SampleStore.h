@@ -0,0 +1,72 @@
+#pragma once
+#include <string.h>
+#include "constants_utils.h"
+
+/* Audio store for the loaded WAV or recorded input, held in one SDRAM buffer.
+  Stereo audio is interleaved (LRLR) so reading a frame fills a single cache
+  line for both channels rather than two lines in separate buffers. Mono audio
+  is stored one sample per frame - it is read into both channels and fits
+  twice as many frames in the buffer.
+  A store can also hold a window of a longer recording (see GrainCache), in
+  which case frames are still addressed by their position in the recording.
+  Everything reading or writing audio goes through Read/Write */
+class SampleStore {
+  public:
+    SampleStore() : buf_(nullptr), buf_size_(0), shift_(1), len_(0), first_(0) {}
+
+    /// @brief Assigns the buffer the store uses, set to stereo and empty
+    /// @param buf Sample buffer, usually in SDRAM
+    /// @param buf_size Size of the buffer in int16 samples
+    void Init(int16_t *buf, size_t buf_size){
+      buf_ = buf;
+      buf_size_ = buf_size;
+      shift_ = 1;
+      len_ = 0;
+      first_ = 0;
+    }
+
+    /// @brief Sets the layout the buffer is read and written with
+    /// @param channels 1 for mono, 2 for interleaved stereo
+    void SetChannels(size_t channels){ shift_ = channels > 1 ? 1 : 0; }
+    /// @brief Sets the recording frame held at the start of the buffer
+    void SetFirstFrame(size_t frame){ first_ = frame; }
+    /// @brief Sets the number of frames holding audio, clamped to MaxFrames
+    void SetLength(size_t frames){ len_ = frames < MaxFrames() ? frames : MaxFrames(); }
+    /// @brief Zeroes the whole buffer and sets the length to 0
+    void Clear(){
+      memset(buf_, 0, buf_size_*sizeof(int16_t));
+      len_ = 0;
+    }
+
+    size_t Channels() const { return shift_ + 1; }
+    size_t Length() const { return len_; }
+    size_t FirstFrame() const { return first_; }
+    size_t MaxFrames() const { return buf_size_ >> shift_; }
+    /* raw buffer, in file order, for bulk loading */
+    int16_t* Data() { return buf_; }
+    const int16_t* Data() const { return buf_; }
+
+    /// @brief Reads one frame - a mono store returns the same sample for both channels
+    inline void Read(size_t frame, int16_t &left, int16_t &right) const {
+      const int16_t *p = buf_ + ((frame - first_) << shift_);
+      left = p[0];
+      right = p[shift_];
+    }
+    /// @brief Writes one frame - a mono store keeps the left channel only
+    inline void Write(size_t frame, int16_t left, int16_t right){
+      int16_t *p = buf_ + ((frame - first_) << shift_);
+      p[shift_] = right;
+      p[0] = left;
+    }
+
+  private:
+    int16_t *buf_;
+    /* buffer size in samples */
+    size_t buf_size_;
+    /* log2 of the channel count - frame index to sample index */
+    size_t shift_;
+    /* frames of audio in the store */
+    size_t len_;
+    /* recording frame at the start of the buffer */
+    size_t first_;
+};
@@ -0,0 +1,144 @@
+#include "StageProfiler.h"
+#include <string.h>
+#if !defined(STM32H750xx) && (defined(__x86_64__) || defined(__i386__))
+#include <chrono>
+#endif
+
+#ifdef STAGE_PROFILER
+StageProfiler stage_profiler;
+#endif
+
+/// @brief Starts the tick counter and clears the tables. On the Pod this turns
+///        on the DWT cycle counter, on x86 it times the TSC against the clock
+void StageProfiler::Init(){
+#if defined(STM32H750xx)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  /* the M7's DWT is locked until the key is written */
+  DWT->LAR = 0xC5ACCE55;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  ticks_per_second_ = SystemCoreClock;
+#elif defined(__x86_64__) || defined(__i386__)
+  using namespace std::chrono;
+  const auto start = steady_clock::now();
+  const uint64_t start_tsc = __rdtsc();
+  while (steady_clock::now() - start < milliseconds(20)) {}
+  const uint64_t tsc = __rdtsc() - start_tsc;
+  const double secs = duration<double>(steady_clock::now() - start).count();
+  ticks_per_second_ = static_cast<uint32_t>(tsc / secs);
+#endif
+  memset(pending_, 0, sizeof(pending_));
+  ran_ = 0;
+  for (Table &table : tables_) table.seq.store(0, std::memory_order_relaxed);
+  Clear();
+}
+
+/// @brief Files this block's total for each stage that ran, then starts the next
+///        block. Call at the end of the audio callback
+void StageProfiler::EndBlock(){
+  if (reset_.exchange(false, std::memory_order_acquire)) Clear();
+  for (size_t i=0; i<kNumStages; i++){
+    if (!(ran_ & (1u << i))) continue;
+    Commit(tables_[i], pending_[i]);
+    pending_[i] = 0;
+  }
+  ran_ = 0;
+}
+
+/// @brief Adds a block's ticks to a stage's table, flagging the write in its
+///        sequence count
+void StageProfiler::Commit(Table &table, uint32_t ticks){
+  uint32_t seq = table.seq.load(std::memory_order_relaxed);
+  table.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (table.blocks == 0 || ticks < table.min) table.min = ticks;
+  if (ticks > table.max) table.max = ticks;
+  table.sum += ticks;
+  table.blocks++;
+  table.hist[Bucket(ticks)]++;
+  table.seq.store(seq + 2, std::memory_order_release);
+}
+
+void StageProfiler::Clear(){
+  for (Table &table : tables_){
+    uint32_t seq = table.seq.load(std::memory_order_relaxed);
+    table.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    table.blocks = 0;
+    table.min = 0;
+    table.max = 0;
+    table.sum = 0;
+    memset(table.hist, 0, sizeof(table.hist));
+    table.seq.store(seq + 2, std::memory_order_release);
+  }
+}
+
+/// @brief Copies out a stage's figures. Call from the main loop - a copy the
+///        callback wrote over partway is thrown away and tried again
+/// @param stage Stage to read
+/// @param stats Filled with the figures, untouched if this returns false
+/// @return False if the stage hasn't run since the last reset, or the callback
+///         kept writing to it
+bool StageProfiler::Read(ProfileStage stage, StageStats &stats) const{
+  const Table &table = tables_[static_cast<size_t>(stage)];
+  uint32_t hist[kNumBuckets];
+  for (size_t attempt=0; attempt<4; attempt++){
+    uint32_t seq = table.seq.load(std::memory_order_acquire);
+    if (seq & 1) continue;
+    const uint32_t blocks = table.blocks;
+    const uint32_t min = table.min;
+    const uint32_t max = table.max;
+    const uint64_t sum = table.sum;
+    memcpy(hist, table.hist, sizeof(hist));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (table.seq.load(std::memory_order_relaxed) != seq) continue;
+    if (blocks == 0) return false;
+
+    /* the bucket holding the block ranked 99% of the way up */
+    const uint32_t rank = blocks - blocks / 100;
+    uint32_t count = 0;
+    size_t bucket = 0;
+    while (bucket < kNumBuckets - 1 && (count += hist[bucket]) < rank) bucket++;
+    const uint32_t top = BucketTop(bucket);
+
+    stats.blocks = blocks;
+    stats.min = min;
+    stats.avg = static_cast<uint32_t>(sum / blocks);
+    stats.p99 = top < max ? top : max;
+    stats.max = max;
+    return true;
+  }
+  return false;
+}
+
+const char* StageProfiler::StageName(ProfileStage stage){
+  switch (stage){
+    case ProfileStage::GrainTrigger: return "trigger";
+    case ProfileStage::GrainRender: return "render";
+    case ProfileStage::Hipass: return "hipass";
+    case ProfileStage::Moog: return "moog";
+    case ProfileStage::Reverb: return "reverb";
+    case ProfileStage::Hicut: return "hicut";
+    case ProfileStage::Limiter: return "limiter";
+    case ProfileStage::WavWriter: return "wav";
+    default: return "?";
+  }
+}
+
+/// @brief Histogram bucket of a tick count - exact below kBucketsPerOctave,
+///        then the octave and the next 3 bits down
+size_t StageProfiler::Bucket(uint32_t ticks){
+  if (ticks < kBucketsPerOctave) return ticks;
+  const uint32_t octave = 31 - __builtin_clz(ticks);
+  const uint32_t sub = (ticks >> (octave - 3)) & (kBucketsPerOctave - 1);
+  return (octave - 2) * kBucketsPerOctave + sub;
+}
+
+/// @brief Highest tick count that falls in a bucket
+uint32_t StageProfiler::BucketTop(size_t bucket){
+  if (bucket < kBucketsPerOctave) return bucket;
+  const uint32_t octave = bucket / kBucketsPerOctave + 2;
+  const uint32_t sub = bucket % kBucketsPerOctave;
+  const uint32_t width = 1u << (octave - 3);
+  return static_cast<uint32_t>((kBucketsPerOctave + sub) << (octave - 3)) + (width - 1);
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#if defined(STM32H750xx)
+#include "stm32h7xx.h"
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* stages of the audio callback the profiler times */
+enum class ProfileStage {
+  GrainTrigger,   /* scheduling and starting grains */
+  GrainRender,
+  Hipass,
+  Moog,
+  Reverb,
+  Hicut,
+  Limiter,
+  WavWriter,      /* sampling the output into the recording */
+  NUM_STAGES
+};
+
+/* what one stage has cost since the last reset, in ticks per block */
+struct StageStats {
+  /* blocks the stage ran in */
+  uint32_t blocks;
+  uint32_t min;
+  uint32_t avg;
+  /* 99th percentile, rounded up to the top of its histogram bucket */
+  uint32_t p99;
+  uint32_t max;
+};
+
+/* Per stage cycle counts for the audio callback, to find which stage ate the
+  budget when a block overruns. Each PROFILE_STAGE scope adds the ticks it took
+  to its stage's total for the block, and EndBlock files the totals in a table
+  per stage - min, max, sum and a histogram for the p99 with 8 buckets per
+  octave, so the percentile is within 12.5%.
+  Ticks are CPU cycles from the DWT counter on the Pod and the TSC on x86
+  hosts, anywhere else nanoseconds.
+  The callback is the only writer. Each stage's table is guarded by a seqlock
+  (see ParamSnapshot), so Read from the main loop never blocks the callback
+  and never sees a half updated table; Reset only raises a flag that the
+  callback acts on at the end of its next block.
+  Profiling is compiled in with -DSTAGE_PROFILER. Without it PROFILE_STAGE
+  is empty and the callback carries no trace of it */
+class StageProfiler {
+  public:
+    static constexpr size_t kNumStages = static_cast<size_t>(ProfileStage::NUM_STAGES);
+    static constexpr size_t kBucketsPerOctave = 8;
+    /* values under kBucketsPerOctave get a bucket each, then 8 per octave up to 2^32 */
+    static constexpr size_t kNumBuckets = (32 - 2) * kBucketsPerOctave;
+
+    StageProfiler() : ran_(0), reset_(false), ticks_per_second_(1000000000) {}
+
+    void Init();
+    void EndBlock();
+    void Reset() { reset_.store(true, std::memory_order_release); }
+    bool Read(ProfileStage stage, StageStats &stats) const;
+    uint32_t TicksPerSecond() const { return ticks_per_second_; }
+    static const char* StageName(ProfileStage stage);
+
+    /// @brief Adds time spent in a stage to its total for this block. Call from
+    ///        the audio callback only
+    void Add(ProfileStage stage, uint32_t ticks){
+      const size_t i = static_cast<size_t>(stage);
+      pending_[i] += ticks;
+      ran_ |= 1u << i;
+    }
+
+    /// @brief Reads the tick counter
+    static uint32_t Now(){
+#if defined(STM32H750xx)
+      return DWT->CYCCNT;
+#elif defined(__x86_64__) || defined(__i386__)
+      return static_cast<uint32_t>(__rdtsc());
+#else
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<uint32_t>(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+    }
+
+  private:
+    struct Table {
+      std::atomic<uint32_t> seq;
+      uint32_t blocks;
+      uint32_t min;
+      uint32_t max;
+      uint64_t sum;
+      uint32_t hist[kNumBuckets];
+    };
+    Table tables_[kNumStages];
+    /* ticks each stage has taken so far this block, and which stages ran */
+    uint32_t pending_[kNumStages] = {};
+    uint32_t ran_;
+    std::atomic<bool> reset_;
+    uint32_t ticks_per_second_;
+
+    void Commit(Table &table, uint32_t ticks);
+    void Clear();
+    static size_t Bucket(uint32_t ticks);
+    static uint32_t BucketTop(size_t bucket);
+};
+
+/* adds the time from construction to destruction to a stage */
+class ProfileScope {
+  public:
+    ProfileScope(StageProfiler &profiler, ProfileStage stage)
+      : profiler_(profiler), stage_(stage), start_(StageProfiler::Now()) {}
+    ~ProfileScope() { profiler_.Add(stage_, StageProfiler::Now() - start_); }
+
+  private:
+    StageProfiler &profiler_;
+    ProfileStage stage_;
+    uint32_t start_;
+};
+
+#ifdef STAGE_PROFILER
+extern StageProfiler stage_profiler;
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+/* times the rest of the enclosing scope as eg PROFILE_STAGE(Reverb) */
+#define PROFILE_STAGE(stage) \
+  ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(stage_profiler, ProfileStage::stage)
+#else
+#define PROFILE_STAGE(stage) do {} while (0)
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+/* Knob-controlled synth and FX parameters as normalised (0-1) knob values.
+  The UI loop owns one copy and publishes it whole through a ParamSnapshot;
+  the audio callback reads the latest at the start of a block and applies
+  the fields that changed, so nothing the callback reads is written mid-block */
+struct SynthParams {
+  float grain_size;
+  float spawn_pos;
+  float pitch;
+  float density;
+  float pan;
+  float pan_width;
+  /* share of a Tukey grain spent fading in and out */
+  float window_taper;
+  float reverb_feedback;
+  float reverb_mix;
+  float lowpass;
+  float hipass;
+};
+
+/* where the knobs start - synth controls centred, reverb and filters nearly off */
+constexpr SynthParams kDefaultSynthParams = {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.05f, 0.05f, 0.05f, 0.05f};
+/* outside the knob range - a snapshot compared against it has every field applied */
+constexpr SynthParams kUnappliedParams = {-1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f};
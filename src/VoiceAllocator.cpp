@@ -0,0 +1,143 @@
+#include "VoiceAllocator.h"
+#include <algorithm>
+
+static_assert(GrainPoolImpl::kMaxOwners >= 2 + MAX_VOICES,
+              "every voice needs its own grain pool owner");
+
+/// @brief Sets every voice idle and gives each its grain budget in the pool
+/// @param pool Grain pool the voices play grains in
+/// @param first_owner Owner tag of voice 0, the voices use the tags after it
+/// @param sample_rate Audio sample rate in Hz
+void VoiceAllocator::Init(GrainPoolImpl *pool, uint8_t first_owner, float sample_rate){
+  pool_ = pool;
+  first_owner_ = first_owner;
+  sample_rate_ = sample_rate;
+  release_samples_ = 0.2f * sample_rate;
+  age_ = 0;
+  for (size_t i=0; i<kMaxVoices; i++){
+    voices_[i].held = false;
+    voices_[i].note = 0;
+    voices_[i].pitch = 1.0f;
+    voices_[i].gain = 0.0f;
+    voices_[i].spawn_pos = 0;
+    voices_[i].age = 0;
+    voices_[i].scheduler.Init(sample_rate);
+    pool_->SetOwnerLimit(Owner(i), VOICE_GRAIN_BUDGET);
+  }
+}
+
+/// @brief Starts a voice for a note. A note that is already held is restarted,
+///        otherwise a free voice is taken, or the oldest note is stolen
+/// @param note MIDI note number, VOICE_ROOT_NOTE plays the sample at its own pitch
+/// @param velocity MIDI velocity (1-127) setting the voice level
+/// @param spawn_pos Position in the audio the voice's grains start from
+void VoiceAllocator::NoteOn(uint8_t note, uint8_t velocity, size_t spawn_pos){
+  size_t voice = FindVoice(note);
+  if (voice == kNoVoice){
+    voice = 0;
+    for (size_t i=1; i<kMaxVoices; i++){
+      /* prefer free voices, then the oldest */
+      const Voice &v = voices_[i];
+      const Voice &best = voices_[voice];
+      if ((!v.held && best.held) || (v.held == best.held && v.age < best.age)){
+        voice = i;
+      }
+    }
+  }
+  if (voices_[voice].held){
+    /* stolen or retriggered - clear the old note's grains out quickly */
+    Release(voice, GrainPoolImpl::kStealFadeSamples);
+  }
+  Voice &v = voices_[voice];
+  v.held = true;
+  v.note = note;
+  /* pitch only changes on note on, so the exact powf is fine here */
+  v.pitch = powf(2.0f, (static_cast<float>(note) - static_cast<float>(VOICE_ROOT_NOTE)) / 12.0f);
+  v.pitch = std::min(std::max(v.pitch, 0.25f), 4.0f);
+  v.gain = static_cast<float>(velocity) / 127.0f;
+  v.spawn_pos = spawn_pos;
+  v.age = age_++;
+  v.scheduler.Restart();
+}
+
+/// @brief Releases the voice playing a note, fading its grains over the release time
+void VoiceAllocator::NoteOff(uint8_t note){
+  size_t voice = FindVoice(note);
+  if (voice != kNoVoice) Release(voice, release_samples_);
+}
+
+/// @brief Releases every held voice
+void VoiceAllocator::AllNotesOff(){
+  for (size_t i=0; i<kMaxVoices; i++){
+    if (voices_[i].held) Release(i, release_samples_);
+  }
+}
+
+/// @brief Finds the held voice playing a note
+/// @return Voice index, or kNoVoice if the note isn't held
+size_t VoiceAllocator::FindVoice(uint8_t note) const {
+  for (size_t i=0; i<kMaxVoices; i++){
+    if (voices_[i].held && voices_[i].note == note) return i;
+  }
+  return kNoVoice;
+}
+
+/// @brief Stops a voice starting grains and fades out the ones it is playing
+void VoiceAllocator::Release(size_t voice, float fade_samples){
+  voices_[voice].held = false;
+  pool_->ReleaseOwner(Owner(voice), fade_samples);
+}
+
+/// @brief Number of notes currently held
+size_t VoiceAllocator::HeldVoices() const {
+  size_t held = 0;
+  for (size_t i=0; i<kMaxVoices; i++){
+    if (voices_[i].held) held++;
+  }
+  return held;
+}
+
+void VoiceAllocator::SetDensity(float grains_per_sec){
+  for (size_t i=0; i<kMaxVoices; i++){
+    voices_[i].scheduler.SetDensity(grains_per_sec);
+  }
+}
+
+void VoiceAllocator::SetSchedulerMode(SchedulerMode mode){
+  for (size_t i=0; i<kMaxVoices; i++){
+    voices_[i].scheduler.SetMode(mode);
+  }
+}
+
+/// @brief Restarts each voice's onset scheduler on its own stream
+/// @param seed Voice i is seeded with seed + i
+void VoiceAllocator::Seed(uint32_t seed){
+  for (size_t i=0; i<kMaxVoices; i++){
+    voices_[i].scheduler.Seed(seed + static_cast<uint32_t>(i));
+  }
+}
+
+/// @brief Adds the grain onsets of every held voice in the next block to a list
+/// @param size Number of samples in the block
+/// @param onsets Onsets already in the block, in order - the voices' onsets are
+///        merged in keeping them in order
+/// @param count Number of onsets already in onsets
+/// @param max_onsets Size of onsets - any further onsets in the block are skipped
+/// @return Number of onsets now in onsets
+size_t VoiceAllocator::NextBlock(size_t size, GrainOnset *onsets, size_t count, size_t max_onsets){
+  uint16_t offsets[kMaxOnsets];
+  for (size_t voice=0; voice<kMaxVoices; voice++){
+    if (!voices_[voice].held) continue;
+    size_t n = voices_[voice].scheduler.NextBlock(size, offsets, kMaxOnsets);
+    for (size_t i=0; i<n && count<max_onsets; i++){
+      /* insertion sort, onsets are few and already nearly in order */
+      size_t j = count++;
+      while (j > 0 && onsets[j-1].offset > offsets[i]){
+        onsets[j] = onsets[j-1];
+        j--;
+      }
+      onsets[j] = {offsets[i], static_cast<uint8_t>(voice)};
+    }
+  }
+  return count;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "constants_utils.h"
+#include "GrainPool.h"
+#include "GrainScheduler.h"
+
+/* a grain start within a block, from the cloud or one of the voices */
+struct GrainOnset {
+  uint16_t offset;
+  uint8_t voice;    /* VoiceAllocator::kNoVoice for the cloud */
+};
+
+/* Polyphonic voice layer played from MIDI notes. Each voice owns a sub-pool
+  of the shared grain pool (its own owner tag, capped at its grain budget),
+  a pitch from its note, a level from its velocity, a spawn position fixed
+  at note on and its own onset scheduler. Note off fades the voice's grains
+  out over the release time.
+  Everything is fixed size - voices are taken from a static array, the
+  oldest note is stolen when all are held, and a voice can never play more
+  than its budget of grains or start more than kMaxOnsets per block, so a
+  full chord costs at most MAX_VOICES * VOICE_GRAIN_BUDGET grain renders */
+class VoiceAllocator {
+  public:
+    static constexpr size_t kMaxVoices = MAX_VOICES;
+    static constexpr uint8_t kNoVoice = 0xFF;
+    /* onsets a voice can start in one block */
+    static constexpr size_t kMaxOnsets = 4;
+
+    VoiceAllocator() : pool_(nullptr), first_owner_(0), release_samples_(0.0f), age_(0) {}
+
+    void Init(GrainPoolImpl *pool, uint8_t first_owner, float sample_rate);
+    void NoteOn(uint8_t note, uint8_t velocity, size_t spawn_pos);
+    void NoteOff(uint8_t note);
+    void AllNotesOff();
+    size_t NextBlock(size_t size, GrainOnset *onsets, size_t count, size_t max_onsets);
+
+    void SetDensity(float grains_per_sec);
+    void SetSchedulerMode(SchedulerMode mode);
+    void Seed(uint32_t seed);
+    void SetReleaseTime(float seconds) { release_samples_ = seconds * sample_rate_; }
+
+    size_t HeldVoices() const;
+    uint8_t Owner(size_t voice) const { return static_cast<uint8_t>(first_owner_ + voice); }
+    float Pitch(size_t voice) const { return voices_[voice].pitch; }
+    float Gain(size_t voice) const { return voices_[voice].gain; }
+    size_t SpawnPos(size_t voice) const { return voices_[voice].spawn_pos; }
+
+  private:
+    struct Voice {
+      bool held;
+      uint8_t note;
+      float pitch;
+      float gain;
+      size_t spawn_pos;
+      /* note on order, lowest is the oldest note */
+      uint32_t age;
+      GrainScheduler scheduler;
+    };
+
+    size_t FindVoice(uint8_t note) const;
+    void Release(size_t voice, float fade_samples);
+
+    GrainPoolImpl *pool_;
+    uint8_t first_owner_;
+    float sample_rate_;
+    float release_samples_;
+    uint32_t age_;
+    Voice voices_[kMaxVoices];
+};
@@ -1,12 +1,25 @@
 #pragma once
 #include "stddef.h"
-#include <time.h>
+#include <stdint.h>
+#include <math.h>
 
 /* audio constants */
 constexpr int SAMPLE_RATE = 48000;
 constexpr float SAMPLE_RATE_FLOAT = 48000.f;
 constexpr int BIT_DEPTH = 16;
 
+/* samples per audio callback - 2, 16, 48 or 128, eg -DAUDIO_BLOCK_SIZE=48.
+  Each callback has a fixed cost on top of its samples (the interrupt, and
+  the per block work of the synth and FX - see gran_bench's callback cases),
+  so bigger blocks leave more of the CPU for grains, at the cost of a block's
+  worth of extra latency: 48 samples is 1ms */
+#ifndef AUDIO_BLOCK_SIZE
+#define AUDIO_BLOCK_SIZE 2
+#endif
+constexpr size_t BLOCK_SIZE = AUDIO_BLOCK_SIZE;
+static_assert(BLOCK_SIZE == 2 || BLOCK_SIZE == 16 || BLOCK_SIZE == 48 || BLOCK_SIZE == 128,
+              "AUDIO_BLOCK_SIZE must be 2, 16, 48 or 128");
+
 /* delay line buffer size (2s @ 48kHz) */
 constexpr size_t DELAY_TIME = 96000;
 
@@ -17,6 +30,10 @@ constexpr size_t MAX_REC_OUT_LEN = 120;
 constexpr size_t CHNL_BUF_SIZE_ABS = 16*1024*1024;
 /* above is absolute size - each sample needs an int16 (2 bytes) so we do (abs_size)/2 */
 constexpr size_t CHNL_BUF_SIZE_SAMPS = 8*1024*1024;
+/* interleaved sample store - room for CHNL_BUF_SIZE_SAMPS stereo frames */
+constexpr size_t SAMPLE_BUF_SIZE_SAMPS = 2*CHNL_BUF_SIZE_SAMPS;
+/* mip-map levels - half then a quarter of the sample store */
+constexpr size_t MIP_BUF_SIZE_SAMPS = SAMPLE_BUF_SIZE_SAMPS/2 + SAMPLE_BUF_SIZE_SAMPS/4;
 
 /* chunk size for reading audio into temporary buffer */
 const size_t BUF_CHUNK_SZ = 16384;
@@ -26,10 +43,33 @@ static const uint16_t MAX_FILES = 32;
 static const uint16_t MAX_FNAME_LEN = 128;
 
 /* granular synth parameter constants */
-constexpr int MIN_GRAINS = 1;
-constexpr int MAX_GRAINS = 15;
-
-static constexpr int NUM_SYNTH_MODES = 4;
+/* size of the grain pool - build with eg -DGRAIN_POOL_SIZE=64 for dense clouds */
+#ifndef GRAIN_POOL_SIZE
+#define GRAIN_POOL_SIZE 15
+#endif
+constexpr int MAX_GRAINS = GRAIN_POOL_SIZE;
+/* most grains the density scheduler keeps playing - leaves room in the pool for chord grains */
+constexpr int MAX_TARGET_GRAINS = MAX_GRAINS - 5;
+/* grain density range in grains per second */
+constexpr float MIN_GRAIN_DENSITY = 0.5f;
+constexpr float MAX_GRAIN_DENSITY = 40.0f;
+/* most grain onsets handled within one audio block */
+constexpr size_t MAX_ONSETS_PER_BLOCK = 16;
+/* MIDI voices and the grains each can play at once - the grain budget is
+  what bounds a voice's CPU cost, eg -DMAX_VOICES=8 -DVOICE_GRAIN_BUDGET=2 */
+#ifndef MAX_VOICES
+#define MAX_VOICES 4
+#endif
+#ifndef VOICE_GRAIN_BUDGET
+#define VOICE_GRAIN_BUDGET 3
+#endif
+/* most notes in a chord, and chords queued for the audio callback */
+constexpr size_t MAX_CHORD_NOTES = 8;
+constexpr size_t CHORD_QUEUE_SIZE = 8;
+/* MIDI note played at the sample's own pitch (middle C) */
+constexpr uint8_t VOICE_ROOT_NOTE = 60;
+
+static constexpr int NUM_SYNTH_MODES = 6;
 constexpr float PARAM_CHANGE_THRESHOLD = 0.01f;
 constexpr float MIN_GRAIN_SIZE_MS = 100.0f;
 constexpr float MAX_GRAIN_SIZE_MS = 3000.0f;
@@ -54,21 +94,8 @@ const float LOPASS_UPPER_BOUND = 18000.0f;
 // const float HICUT_FREQ = 0.3125f; /* 15000Hz @ 48kHz sample rate */
 const float HICUT_FREQ = 0.34375; /* 16500Hz @ 48kHz sample rate */
 
-/* random number generator variables and helper functions */
-extern uint32_t rng_state;
-static inline void SeedRng(){
-  rng_state = static_cast<uint32_t>(time(nullptr));
-}
-static inline float RngFloat(){
-  /* xorshift32 from https://en.wikipedia.org/wiki/Xorshift 
-  for simple fast random floats */
-  rng_state ^= rng_state << 13;
-  rng_state ^= rng_state >> 17;
-  rng_state ^= rng_state << 5;
-  /* ensures output is between 0-1 */
-  float out = static_cast<float>(rng_state) / static_cast<float>(UINT32_MAX);
-  return out;
-}
+/* seed the grain engine's random streams start from, see GranularSynth::SetSeed */
+constexpr uint32_t DEFAULT_RNG_SEED = 0x6772616E;
 
 /* integer clamp as can't use std::clamp */
 static inline constexpr size_t intclamp(size_t val, size_t min, size_t max){
@@ -0,0 +1,78 @@
+#include "ControlScript.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "Csv.h"
+
+struct ScriptControlName {
+  const char *name;
+  ScriptControl control;
+};
+
+static const ScriptControlName kControls[] = {
+  {"knob1", ScriptControl::Knob1},
+  {"knob2", ScriptControl::Knob2},
+  {"encoder", ScriptControl::Encoder},
+  {"button1", ScriptControl::Button1},
+  {"button2", ScriptControl::Button2},
+  {"turn", ScriptControl::Turn},
+  {"note_on", ScriptControl::NoteOn},
+  {"note_off", ScriptControl::NoteOff},
+  {"quit", ScriptControl::Quit},
+};
+
+/// @brief Reads and sorts the events of a control script
+/// @param path CSV file to read
+/// @param error Set to a description of the first bad line on failure
+/// @return False if the file can't be read or has a bad line
+bool ControlScript::Load(const char *path, std::string &error){
+  events_.clear();
+  FILE *f = fopen(path, "r");
+  if (!f){
+    error = std::string("can't open ") + path;
+    return false;
+  }
+  char line[256];
+  size_t line_num = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)){
+    line_num++;
+    char *fields[4] = {nullptr, nullptr, nullptr, nullptr};
+    size_t count = SplitCsvLine(line, fields, 4);
+    if (count == 0) continue;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "line %zu: ", line_num);
+
+    float time;
+    if (count < 2 || !ParseCsvNumber(fields[0], time) || time < 0.0f){
+      error = std::string(msg) + "expected time, control, value";
+      ok = false;
+      break;
+    }
+    const ScriptControlName *ctrl = nullptr;
+    for (const ScriptControlName &c : kControls){
+      if (strcmp(fields[1], c.name) == 0) ctrl = &c;
+    }
+    if (!ctrl){
+      error = std::string(msg) + "unknown control '" + fields[1] + "'";
+      ok = false;
+      break;
+    }
+    ScriptEvent event = {static_cast<uint32_t>(time * 1000.0f + 0.5f), ctrl->control, 0.0f, 100.0f};
+    /* only quit can go without a value */
+    bool needs_value = ctrl->control != ScriptControl::Quit;
+    if ((needs_value && count < 3) ||
+        (count > 2 && !ParseCsvNumber(fields[2], event.value)) ||
+        (count > 3 && !ParseCsvNumber(fields[3], event.value2))){
+      error = std::string(msg) + "bad value for " + ctrl->name;
+      ok = false;
+      break;
+    }
+    events_.push_back(event);
+  }
+  fclose(f);
+  if (!ok) return false;
+  std::stable_sort(events_.begin(), events_.end(),
+                   [](const ScriptEvent &a, const ScriptEvent &b){ return a.time_ms < b.time_ms; });
+  return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/* what a script event does to the Pod's controls */
+enum class ScriptControl {
+  Knob1,    /* position 0-1 */
+  Knob2,
+  Encoder,  /* press, value is how long it's held in seconds */
+  Button1,
+  Button2,
+  Turn,     /* encoder detents, negative turns it back */
+  NoteOn,   /* value is the MIDI note, value2 the velocity */
+  NoteOff,
+  Quit      /* ends the run */
+};
+
+struct ScriptEvent {
+  uint32_t time_ms;
+  ScriptControl control;
+  float value;
+  float value2;
+};
+
+/* Scripted control input for the host platform, read from a CSV file in the
+  same form as the renderer's Timeline:
+
+    time_seconds, control, value[, value2]
+
+  eg "0.5, encoder, 0.05" presses the encoder for 50ms, "3, encoder, 1.5" is
+  a long press, "4, turn, -2" turns it back two detents and "5, knob1, 0.8"
+  moves a knob. Controls are knob1, knob2, encoder, button1, button2, turn,
+  note_on, note_off (MIDI into the Pod's port) and quit, whose value is
+  ignored. Blank lines and lines starting with # are skipped. Events are
+  sorted by time, keeping file order for ties */
+class ControlScript {
+  public:
+    bool Load(const char *path, std::string &error);
+
+    const std::vector<ScriptEvent>& Events() const { return events_; }
+    /* time of the last event, 0 if there are none */
+    uint32_t EndMs() const { return events_.empty() ? 0 : events_.back().time_ms; }
+
+  private:
+    std::vector<ScriptEvent> events_;
+};
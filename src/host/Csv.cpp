@@ -0,0 +1,34 @@
+#include "Csv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* strips leading and trailing whitespace in place */
+static char* Trim(char *s){
+  while (isspace(static_cast<unsigned char>(*s))) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace(static_cast<unsigned char>(end[-1]))) end--;
+  *end = '\0';
+  return s;
+}
+
+/// @brief Splits a CSV line into trimmed fields
+/// @param line Line to split, modified in place
+/// @param fields Filled with pointers into line
+/// @param max_fields Size of fields, later fields are dropped
+/// @return Number of fields, 0 for blank and comment lines
+size_t SplitCsvLine(char *line, char **fields, size_t max_fields){
+  char *s = Trim(line);
+  if (*s == '\0' || *s == '#') return 0;
+  size_t count = 0;
+  for (char *tok = strtok(s, ","); tok && count < max_fields; tok = strtok(nullptr, ",")){
+    fields[count++] = Trim(tok);
+  }
+  return count;
+}
+
+bool ParseCsvNumber(const char *s, float &out){
+  char *end;
+  out = strtof(s, &end);
+  return end != s && *end == '\0';
+}
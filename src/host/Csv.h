@@ -0,0 +1,11 @@
+#pragma once
+#include <stddef.h>
+
+/* Line helpers shared by the CSV files the host tools read - the renderer's
+  Timeline and the platform's ControlScript */
+
+/* splits a line on commas in place, trimming each field. Returns the number
+  of fields, 0 for a blank line or a # comment */
+size_t SplitCsvLine(char *line, char **fields, size_t max_fields);
+/* true if all of s is a number */
+bool ParseCsvNumber(const char *s, float &out);
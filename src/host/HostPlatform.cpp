@@ -0,0 +1,225 @@
+#include "HostPlatform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <chrono>
+#include <string>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "daisy_core.h"
+#include "HostSdCard.h"
+
+using namespace daisy;
+
+static constexpr uint32_t kSampleRate = 48000;
+/* how long a run goes on after the script's last event, if it has no quit */
+static constexpr uint32_t kTailMs = 1000;
+
+static std::chrono::steady_clock::time_point wall_start;
+
+HostPlatform& HostPlatform::Get(){
+  static HostPlatform platform;
+  return platform;
+}
+
+/// @brief Reads the platform setup from the environment, see HostPlatform.h.
+///        Exits if a file it names can't be used
+void HostPlatform::Init(){
+  if (initialised_) return;
+  initialised_ = true;
+#ifdef __SSE__
+  /* flush denormals to zero as the Pod's FPU effectively does, see gran_render */
+  _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+  const char *trace = getenv("GRAN_TRACE");
+  trace_ = trace && trace[0] == '1';
+  const char *image = getenv("GRAN_SD_IMAGE");
+  if (image) sd_image_path_ = image;
+
+  const char *script = getenv("GRAN_SCRIPT");
+  if (script){
+    std::string error;
+    if (!script_.Load(script, error)){
+      fprintf(stderr, "%s: %s\n", script, error.c_str());
+      exit(1);
+    }
+  }
+  quit_ms_ = script_.EndMs() + kTailMs;
+  for (const ScriptEvent &e : script_.Events()){
+    if (e.control == ScriptControl::Quit){
+      quit_ms_ = e.time_ms;
+      break;
+    }
+  }
+
+  const char *in_path = getenv("GRAN_AUDIO_IN");
+  if (in_path){
+    if (!ReadWav(in_path, audio_in_)){
+      fprintf(stderr, "can't read %s - needs 16/24/32 bit PCM or float WAV\n", in_path);
+      exit(1);
+    }
+    if (audio_in_.sample_rate != kSampleRate){
+      fprintf(stderr, "warning: %s is %uHz, it plays as if it were %uHz\n", in_path, audio_in_.sample_rate, kSampleRate);
+    }
+  }
+  const char *out_path = getenv("GRAN_AUDIO_OUT");
+  if (out_path){
+    if (!audio_out_.Open(out_path, kSampleRate, true)){
+      fprintf(stderr, "can't write %s\n", out_path);
+      exit(1);
+    }
+    writing_out_ = true;
+  }
+  SetBlockSize(block_size_);
+  wall_start = std::chrono::steady_clock::now();
+}
+
+/// @brief Runs the simulated clock forward a millisecond at a time, applying the
+///        script events and running the audio blocks that fall due in each
+/// @param us Time to advance in microseconds
+void HostPlatform::Advance(uint32_t us){
+  const uint64_t target = now_us_ + us;
+  while (now_us_ < target){
+    const uint64_t next_ms = (now_us_ / 1000 + 1) * 1000;
+    now_us_ = next_ms < target ? next_ms : target;
+    ApplyEvents();
+    RunAudio();
+  }
+}
+
+/// @brief Finishes the output file and exits, reporting the run's speed
+/// @param status Exit status
+void HostPlatform::Quit(int status){
+  const double wall_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  if (writing_out_ && !audio_out_.Close()){
+    fprintf(stderr, "failed writing the audio output\n");
+    status = 1;
+  }
+  CloseSdImage();
+  const double sim_secs = static_cast<double>(now_us_) / 1e6;
+  fprintf(stderr, "ran %.2fs in %.3fs, %.1fx realtime, %llu audio callbacks of %zu\n",
+          sim_secs, wall_secs, wall_secs > 0.0 ? sim_secs / wall_secs : 0.0,
+          static_cast<unsigned long long>(callbacks_), block_size_);
+  exit(status);
+}
+
+/// @brief Sets the audio block size, as SetAudioBlockSize does on the Pod
+void HostPlatform::SetBlockSize(size_t size){
+  block_size_ = size > 0 ? size : 1;
+  for (size_t c=0; c<2; c++){
+    in_buf_[c].assign(block_size_, 0.0f);
+    out_buf_[c].assign(block_size_, 0.0f);
+  }
+}
+
+int32_t HostPlatform::TakeDetent(){
+  if (detents_ == 0) return 0;
+  const int32_t step = detents_ > 0 ? 1 : -1;
+  detents_ -= step;
+  return step;
+}
+
+void HostPlatform::SetMidiInput(HostMidiCallback callback, void *context){
+  midi_callback_ = callback;
+  midi_context_ = context;
+}
+
+void HostPlatform::Trace(const char *format, ...){
+  if (!trace_) return;
+  fprintf(stderr, "[%8.3f] ", static_cast<double>(now_us_) / 1e6);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+/// @brief Releases switches whose hold time is up and applies the script events
+///        that are due, quitting once the run is over
+void HostPlatform::ApplyEvents(){
+  const uint32_t now = NowMs();
+  for (size_t i=0; i<static_cast<size_t>(HostSwitch::NUM_SWITCHES); i++){
+    if (switch_down_[i] && now >= release_ms_[i]) switch_down_[i] = false;
+  }
+  const std::vector<ScriptEvent> &events = script_.Events();
+  while (next_event_ < events.size() && events[next_event_].time_ms <= now){
+    ApplyEvent(events[next_event_++]);
+  }
+  if (now >= quit_ms_) Quit(0);
+}
+
+void HostPlatform::ApplyEvent(const ScriptEvent &e){
+  switch (e.control){
+    case ScriptControl::Knob1:
+    case ScriptControl::Knob2: {
+      size_t idx = e.control == ScriptControl::Knob1 ? 0 : 1;
+      knobs_[idx] = e.value < 0.0f ? 0.0f : (e.value > 1.0f ? 1.0f : e.value);
+      Trace("knob%zu %.3f", idx + 1, knobs_[idx]);
+      break;
+    }
+    case ScriptControl::Encoder: PressSwitch(HostSwitch::Encoder, e.value); break;
+    case ScriptControl::Button1: PressSwitch(HostSwitch::Button1, e.value); break;
+    case ScriptControl::Button2: PressSwitch(HostSwitch::Button2, e.value); break;
+    case ScriptControl::Turn:
+      detents_ += static_cast<int32_t>(e.value);
+      Trace("turn %d", static_cast<int>(e.value));
+      break;
+    case ScriptControl::NoteOn:
+      SendMidi(0x90, static_cast<uint8_t>(e.value), static_cast<uint8_t>(e.value2));
+      break;
+    case ScriptControl::NoteOff:
+      SendMidi(0x80, static_cast<uint8_t>(e.value), 0);
+      break;
+    case ScriptControl::Quit:
+      break;
+  }
+}
+
+/// @brief Holds a switch down for hold_s seconds - at least a millisecond, so the
+///        app's debounce sees it
+void HostPlatform::PressSwitch(HostSwitch sw, float hold_s){
+  static const char *const kNames[] = {"encoder", "button1", "button2"};
+  const size_t idx = static_cast<size_t>(sw);
+  const uint32_t hold_ms = hold_s > 0.001f ? static_cast<uint32_t>(hold_s * 1000.0f + 0.5f) : 1;
+  switch_down_[idx] = true;
+  release_ms_[idx] = NowMs() + hold_ms;
+  Trace("press %s for %ums", kNames[idx], hold_ms);
+}
+
+void HostPlatform::SendMidi(uint8_t status, uint8_t data1, uint8_t data2){
+  Trace("midi %02x %u %u", status, data1, data2);
+  if (!midi_callback_) return;
+  uint8_t bytes[3] = {status, static_cast<uint8_t>(data1 & 0x7F), static_cast<uint8_t>(data2 & 0x7F)};
+  midi_callback_(bytes, sizeof(bytes), midi_context_);
+}
+
+/// @brief Calls the audio callback for each whole block up to the current time.
+///        The input keeps flowing while audio is stopped, and the output is
+///        silent, so both files stay in step with the simulated clock
+void HostPlatform::RunAudio(){
+  const uint64_t due = now_us_ * kSampleRate / 1000000;
+  while (frames_done_ + block_size_ <= due){
+    for (size_t i=0; i<block_size_; i++){
+      const uint64_t frame = frames_done_ + i;
+      for (size_t c=0; c<2; c++){
+        float s = 0.0f;
+        if (frame < audio_in_.frames){
+          /* mono input feeds both channels */
+          const size_t ch = c < audio_in_.channels ? c : 0;
+          s = s162f(audio_in_.samples[frame * audio_in_.channels + ch]);
+        }
+        in_buf_[c][i] = s;
+        out_buf_[c][i] = 0.0f;
+      }
+    }
+    if (callback_){
+      const float *in[2] = {in_buf_[0].data(), in_buf_[1].data()};
+      float *out[2] = {out_buf_[0].data(), out_buf_[1].data()};
+      callback_(in, out, block_size_);
+      callbacks_++;
+    }
+    if (writing_out_) audio_out_.Write(out_buf_[0].data(), out_buf_[1].data(), block_size_);
+    frames_done_ += block_size_;
+  }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "hid/audio.h"
+#include "ControlScript.h"
+#include "WavFile.h"
+
+/* the Pod's switches, as HostPlatform tracks them */
+enum class HostSwitch {
+  Encoder,
+  Button1,
+  Button2,
+  NUM_SWITCHES
+};
+
+/* receives MIDI bytes, the same as MidiUartTransport::MidiRxParseCallback */
+typedef void (*HostMidiCallback)(uint8_t *data, size_t size, void *context);
+
+/* Host platform - the simulated Pod behind the stand-ins in daisy_pod.h and
+  sys/system.h, so the app runs unchanged on a workstation.
+
+  Time is simulated and only moves when the app waits: System::Delay runs the
+  clock forward, applying the control script and calling the audio callback
+  for every block that falls due, as the SAI interrupt would. A run takes as
+  long as the app's own work, and gives the same result under perf, a
+  debugger or sanitizers. A switch polled twice in the same millisecond moves
+  the clock on by one, so the app's wait-for-release loops see the release.
+
+  main() takes no arguments, so the platform reads its setup from the
+  environment when the Pod is initialised:
+    GRAN_SD_IMAGE   FAT image standing in for the SD card, default sd.img -
+                    make one with sd_image
+    GRAN_SCRIPT     control script, see ControlScript.h
+    GRAN_AUDIO_IN   WAV file fed to the audio input, silence once it ends
+    GRAN_AUDIO_OUT  file the audio output is written to as 32 bit float WAV,
+                    discarded if unset
+    GRAN_TRACE      set to 1 to print script events and LED changes
+  The run ends at a quit event in the script, or a second after its last
+  event, and prints how fast it ran */
+class HostPlatform {
+  public:
+    static HostPlatform& Get();
+
+    void Init();
+    /* runs the clock forward, see above */
+    void Advance(uint32_t us);
+    uint32_t NowMs() const { return static_cast<uint32_t>(now_us_ / 1000); }
+    uint32_t NowUs() const { return static_cast<uint32_t>(now_us_); }
+    /* flushes the output file, reports the run and exits */
+    [[noreturn]] void Quit(int status);
+
+    /* audio driver */
+    void SetBlockSize(size_t size);
+    size_t BlockSize() const { return block_size_; }
+    void StartAudio(daisy::AudioHandle::AudioCallback callback){ callback_ = callback; }
+    void StopAudio(){ callback_ = nullptr; }
+
+    /* control state, as last set by the script */
+    float Knob(size_t idx) const { return knobs_[idx]; }
+    bool SwitchDown(HostSwitch sw) const { return switch_down_[static_cast<size_t>(sw)]; }
+    /* one encoder detent from the pending turns, 0 if there are none */
+    int32_t TakeDetent();
+    /* MIDI bytes from note events go to this parser, like the UART's receive callback */
+    void SetMidiInput(HostMidiCallback callback, void *context);
+
+    const char* SdImagePath() const { return sd_image_path_; }
+    /* prints a line stamped with the simulated time, if GRAN_TRACE is set */
+    void Trace(const char *format, ...);
+
+  private:
+    HostPlatform() {}
+    void ApplyEvents();
+    void ApplyEvent(const ScriptEvent &e);
+    void PressSwitch(HostSwitch sw, float hold_s);
+    void SendMidi(uint8_t status, uint8_t data1, uint8_t data2);
+    void RunAudio();
+
+    bool initialised_ = false;
+    bool trace_ = false;
+    const char *sd_image_path_ = "sd.img";
+    uint64_t now_us_ = 0;
+
+    ControlScript script_;
+    size_t next_event_ = 0;
+    uint32_t quit_ms_ = 1000;
+
+    float knobs_[2] = {0.5f, 0.5f};
+    bool switch_down_[static_cast<size_t>(HostSwitch::NUM_SWITCHES)] = {};
+    uint32_t release_ms_[static_cast<size_t>(HostSwitch::NUM_SWITCHES)] = {};
+    int32_t detents_ = 0;
+    HostMidiCallback midi_callback_ = nullptr;
+    void *midi_context_ = nullptr;
+
+    /* audio, run in blocks of block_size_ */
+    daisy::AudioHandle::AudioCallback callback_ = nullptr;
+    size_t block_size_ = 48;
+    uint64_t frames_done_ = 0;
+    uint64_t callbacks_ = 0;
+    std::vector<float> in_buf_[2];
+    std::vector<float> out_buf_[2];
+    WavData audio_in_;
+    HostWavWriter audio_out_;
+    bool writing_out_ = false;
+};
@@ -0,0 +1,127 @@
+#include "HostSdCard.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sys/fatfs.h"
+
+using namespace daisy;
+
+static constexpr size_t kSectorSize = 512;
+
+static int image_fd = -1;
+static DWORD image_sectors = 0;
+
+/// @brief Opens the disk image the SD card driver reads and writes
+/// @param path Image file
+/// @param create_bytes Size of a new blank image to create, or 0 to open an existing one
+/// @return False if the file can't be opened or created
+bool OpenSdImage(const char *path, size_t create_bytes){
+  CloseSdImage();
+  int flags = create_bytes ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR;
+  image_fd = open(path, flags, 0644);
+  if (image_fd < 0) return false;
+  /* a new image is sparse, so a big card costs little disk */
+  if (create_bytes && ftruncate(image_fd, static_cast<off_t>(create_bytes)) != 0){
+    CloseSdImage();
+    return false;
+  }
+  struct stat st;
+  if (fstat(image_fd, &st) != 0 || st.st_size < static_cast<off_t>(kSectorSize)){
+    CloseSdImage();
+    return false;
+  }
+  image_sectors = static_cast<DWORD>(st.st_size / kSectorSize);
+  return true;
+}
+
+void CloseSdImage(){
+  if (image_fd >= 0) close(image_fd);
+  image_fd = -1;
+  image_sectors = 0;
+}
+
+bool SdImageOpen(){
+  return image_fd >= 0;
+}
+
+static DSTATUS ImageStatus(BYTE lun){
+  return image_fd >= 0 ? 0 : STA_NOINIT;
+}
+
+static DSTATUS ImageInitialize(BYTE lun){
+  return ImageStatus(lun);
+}
+
+static DRESULT ImageRead(BYTE lun, BYTE *buff, DWORD sector, UINT count){
+  if (image_fd < 0) return RES_NOTRDY;
+  if (sector + count > image_sectors) return RES_PARERR;
+  const size_t bytes = count * kSectorSize;
+  ssize_t n = pread(image_fd, buff, bytes, static_cast<off_t>(sector) * kSectorSize);
+  return n == static_cast<ssize_t>(bytes) ? RES_OK : RES_ERROR;
+}
+
+static DRESULT ImageWrite(BYTE lun, const BYTE *buff, DWORD sector, UINT count){
+  if (image_fd < 0) return RES_NOTRDY;
+  if (sector + count > image_sectors) return RES_PARERR;
+  const size_t bytes = count * kSectorSize;
+  ssize_t n = pwrite(image_fd, buff, bytes, static_cast<off_t>(sector) * kSectorSize);
+  return n == static_cast<ssize_t>(bytes) ? RES_OK : RES_ERROR;
+}
+
+static DRESULT ImageIoctl(BYTE lun, BYTE cmd, void *buff){
+  if (image_fd < 0) return RES_NOTRDY;
+  switch (cmd){
+    case CTRL_SYNC:
+      return fsync(image_fd) == 0 ? RES_OK : RES_ERROR;
+    case GET_SECTOR_COUNT:
+      *static_cast<DWORD*>(buff) = image_sectors;
+      return RES_OK;
+    case GET_SECTOR_SIZE:
+      *static_cast<WORD*>(buff) = kSectorSize;
+      return RES_OK;
+    case GET_BLOCK_SIZE:
+      /* erase block in sectors, unknown */
+      *static_cast<DWORD*>(buff) = 1;
+      return RES_OK;
+    default:
+      return RES_PARERR;
+  }
+}
+
+const Diskio_drvTypeDef HostSdDriver = {
+  ImageInitialize,
+  ImageStatus,
+  ImageRead,
+  ImageWrite,
+  ImageIoctl,
+};
+
+/* FatFSInterface as in libDaisy's sys/fatfs.cpp, with the image driver in
+  place of the SDMMC one. There's no USB host here */
+FatFSInterface::Result FatFSInterface::Init(const FatFSInterface::Config& cfg){
+  Result ret = Result::ERR_NO_MEDIA_SELECTED;
+  cfg_ = cfg;
+  if (cfg_.media & Config::MEDIA_SD){
+    ret = FATFS_LinkDriver(&HostSdDriver, path_[0]) == FR_OK ? Result::OK : Result::ERR_TOO_MANY_VOLUMES;
+  }
+  if (ret == Result::OK) initialized_ = true;
+  return ret;
+}
+
+FatFSInterface::Result FatFSInterface::Init(const uint8_t media){
+  cfg_.media = media;
+  return Init(cfg_);
+}
+
+FatFSInterface::Result FatFSInterface::DeInit(){
+  Result ret = Result::ERR_NO_MEDIA_SELECTED;
+  if (cfg_.media & Config::MEDIA_SD){
+    ret = FATFS_UnLinkDriver(path_[0]) == FR_OK ? Result::OK : Result::ERR_TOO_MANY_VOLUMES;
+  }
+  if (ret == Result::OK) initialized_ = false;
+  return ret;
+}
+
+extern "C" {
+  DWORD get_fattime(void) { return 0; }
+}
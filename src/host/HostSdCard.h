@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include "ff_gen_drv.h"
+
+/* Host SD card - a FAT disk image file in place of the Pod's card, read and
+  written a sector at a time through FatFs's generic driver layer, so the
+  app's file code runs unchanged. Make and fill images with sd_image */
+
+/* opens an image, or creates a blank one of create_bytes if that isn't 0.
+  Only one image is open at a time */
+bool OpenSdImage(const char *path, size_t create_bytes = 0);
+void CloseSdImage();
+bool SdImageOpen();
+
+/* the driver FatFSInterface links for MEDIA_SD */
+extern const Diskio_drvTypeDef HostSdDriver;
@@ -0,0 +1,111 @@
+#include "Timeline.h"
+#include <stdio.h>
+#include <string.h>
+#include "Csv.h"
+#include <algorithm>
+
+struct ControlName {
+  const char *name;
+  TimelineControl control;
+  /* names accepted for the value, by index - nullptr if it's a number */
+  const char *const *values;
+};
+
+static const char *const kWindowNames[] = {"hann", "tukey", "gaussian", "trapezoid", "expdecay", nullptr};
+static const char *const kSchedulerNames[] = {"sync", "async", nullptr};
+/* in StealPolicy order */
+static const char *const kStealNames[] = {"none", "oldest", "quietest", "nearest_finish", nullptr};
+/* in ChordType order */
+static const char *const kChordNames[] = {"major", "major7th", "minor", "minor7th", "dominant7th",
+                                          "major9th", "minor9th", "sus2", "sus4", nullptr};
+static const char *const kTuningNames[] = {"equal", "just", nullptr};
+
+static const ControlName kControls[] = {
+  {"grain_size", TimelineControl::GrainSize, nullptr},
+  {"spawn_pos", TimelineControl::SpawnPos, nullptr},
+  {"pitch", TimelineControl::Pitch, nullptr},
+  {"density", TimelineControl::Density, nullptr},
+  {"pan", TimelineControl::Pan, nullptr},
+  {"pan_width", TimelineControl::PanWidth, nullptr},
+  {"window_taper", TimelineControl::WindowTaper, nullptr},
+  {"reverb_feedback", TimelineControl::ReverbFeedback, nullptr},
+  {"reverb_mix", TimelineControl::ReverbMix, nullptr},
+  {"lowpass", TimelineControl::Lowpass, nullptr},
+  {"hipass", TimelineControl::Hipass, nullptr},
+  {"window", TimelineControl::Window, kWindowNames},
+  {"scheduler", TimelineControl::Scheduler, kSchedulerNames},
+  {"steal", TimelineControl::Steal, kStealNames},
+  {"chord", TimelineControl::Chord, kChordNames},
+  {"key", TimelineControl::Key, nullptr},
+  {"inversion", TimelineControl::Inversion, nullptr},
+  {"tuning", TimelineControl::Tuning, kTuningNames},
+  {"note_on", TimelineControl::NoteOn, nullptr},
+  {"note_off", TimelineControl::NoteOff, nullptr},
+};
+
+/* a number, or one of names by index */
+static bool ParseValue(const char *s, const char *const *names, float &out){
+  if (ParseCsvNumber(s, out)) return true;
+  if (!names) return false;
+  for (size_t i=0; names[i]; i++){
+    if (strcmp(s, names[i]) == 0){
+      out = static_cast<float>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief Reads and sorts the events of a timeline file
+/// @param path CSV file to read
+/// @param sample_rate Rate event times are converted to frames at
+/// @param error Set to a description of the first bad line on failure
+/// @return False if the file can't be read or has a bad line
+bool Timeline::Load(const char *path, float sample_rate, std::string &error){
+  events_.clear();
+  FILE *f = fopen(path, "r");
+  if (!f){
+    error = std::string("can't open ") + path;
+    return false;
+  }
+  char line[256];
+  size_t line_num = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)){
+    line_num++;
+    char *fields[4] = {nullptr, nullptr, nullptr, nullptr};
+    size_t count = SplitCsvLine(line, fields, 4);
+    if (count == 0) continue;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "line %zu: ", line_num);
+
+    float time;
+    if (count < 3 || !ParseCsvNumber(fields[0], time) || time < 0.0f){
+      error = std::string(msg) + "expected time, control, value";
+      ok = false;
+      break;
+    }
+    const ControlName *ctrl = nullptr;
+    for (const ControlName &c : kControls){
+      if (strcmp(fields[1], c.name) == 0) ctrl = &c;
+    }
+    if (!ctrl){
+      error = std::string(msg) + "unknown control '" + fields[1] + "'";
+      ok = false;
+      break;
+    }
+    TimelineEvent event = {static_cast<size_t>(time * sample_rate + 0.5f), ctrl->control, 0.0f, 100.0f};
+    if (!ParseValue(fields[2], ctrl->values, event.value) ||
+        (count > 3 && !ParseCsvNumber(fields[3], event.value2))){
+      error = std::string(msg) + "bad value for " + ctrl->name;
+      ok = false;
+      break;
+    }
+    events_.push_back(event);
+  }
+  fclose(f);
+  if (!ok) return false;
+  std::stable_sort(events_.begin(), events_.end(),
+                   [](const TimelineEvent &a, const TimelineEvent &b){ return a.frame < b.frame; });
+  return true;
+}
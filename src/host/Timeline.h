@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/* what a timeline event changes */
+enum class TimelineControl {
+  /* SynthParams fields, normalised 0-1 like the knobs */
+  GrainSize,
+  SpawnPos,
+  Pitch,
+  Density,
+  Pan,
+  PanWidth,
+  WindowTaper,
+  ReverbFeedback,
+  ReverbMix,
+  Lowpass,
+  Hipass,
+  /* discrete controls */
+  Window,     /* WindowShape index */
+  Scheduler,  /* 0 sync, 1 async */
+  Steal,      /* StealPolicy index */
+  Chord,      /* ChordType index - queues the chord */
+  Key,        /* semitones above C */
+  Inversion,
+  Tuning,     /* 0 equal, 1 just */
+  NoteOn,     /* value is the MIDI note, value2 the velocity */
+  NoteOff
+};
+
+struct TimelineEvent {
+  size_t frame;
+  TimelineControl control;
+  float value;
+  float value2;
+};
+
+/* Parameter automation for the offline renderer, read from a CSV file with
+  one event per line:
+
+    time_seconds, control, value[, value2]
+
+  eg "2.5, pitch, 0.75" or "4, chord, minor7th" or "6, note_on, 60, 100".
+  Controls are named as in SynthParams (grain_size, spawn_pos, pitch, density,
+  pan, pan_width, window_taper, reverb_feedback, reverb_mix, lowpass, hipass) plus window,
+  scheduler, steal, chord, key, inversion, tuning, note_on and note_off. Enum values
+  can be given by index or by name. Blank lines and lines starting with #
+  are skipped. Events are sorted by time, keeping file order for ties */
+class Timeline {
+  public:
+    bool Load(const char *path, float sample_rate, std::string &error);
+
+    const std::vector<TimelineEvent>& Events() const { return events_; }
+    /* frame of the last event, 0 if there are none */
+    size_t EndFrame() const { return events_.empty() ? 0 : events_.back().frame; }
+
+  private:
+    std::vector<TimelineEvent> events_;
+};
@@ -0,0 +1,159 @@
+#include "WavFile.h"
+#include <string.h>
+#include <math.h>
+
+/* WAV files are little endian, as are the hosts this builds for */
+static uint32_t ReadU32(const uint8_t *p){ return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+static uint16_t ReadU16(const uint8_t *p){ return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+/* one sample of any supported format, as int16 */
+static int16_t ToInt16(const uint8_t *p, uint16_t format, uint16_t bits){
+  if (format == 3){
+    float f;
+    memcpy(&f, p, sizeof(f));
+    float s = roundf(f * 32767.0f);
+    if (s > 32767.0f) s = 32767.0f;
+    if (s < -32768.0f) s = -32768.0f;
+    return static_cast<int16_t>(s);
+  }
+  /* take the top 16 bits of wider PCM */
+  switch (bits){
+    case 24:
+      return static_cast<int16_t>(ReadU16(p + 1));
+    case 32:
+      return static_cast<int16_t>(ReadU16(p + 2));
+    default:
+      return static_cast<int16_t>(ReadU16(p));
+  }
+}
+
+/// @brief Reads a whole WAV file into interleaved int16
+/// @param path File to read
+/// @param wav Filled with the audio, converted to int16 and at most 2 channels
+/// @return False if the file can't be read or its format isn't supported
+bool ReadWav(const char *path, WavData &wav){
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  std::vector<uint8_t> bytes;
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+  fclose(f);
+
+  if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) != 0 || memcmp(&bytes[8], "WAVE", 4) != 0) return false;
+  uint16_t format = 0, channels = 0, bits = 0;
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;
+  size_t pos = 12;
+  while (pos + 8 <= bytes.size()){
+    const uint8_t *hdr = &bytes[pos];
+    size_t size = ReadU32(hdr + 4);
+    const uint8_t *body = hdr + 8;
+    size_t avail = bytes.size() - pos - 8;
+    if (memcmp(hdr, "fmt ", 4) == 0 && size >= 16 && avail >= 16){
+      format = ReadU16(body);
+      channels = ReadU16(body + 2);
+      wav.sample_rate = ReadU32(body + 4);
+      bits = ReadU16(body + 14);
+      /* WAVE_FORMAT_EXTENSIBLE keeps the real format at the start of the sub format GUID */
+      if (format == 0xFFFE && size >= 26 && avail >= 26) format = ReadU16(body + 24);
+    }
+    else if (memcmp(hdr, "data", 4) == 0){
+      data = body;
+      data_size = size < avail ? size : avail;
+    }
+    /* chunks are padded to an even length */
+    pos += 8 + size + (size & 1);
+  }
+
+  bool pcm = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+  bool flt = format == 3 && bits == 32;
+  if (!data || channels == 0 || !(pcm || flt)) return false;
+
+  const size_t bytes_per_sample = bits / 8;
+  const size_t stride = bytes_per_sample * channels;
+  wav.channels = channels > 1 ? 2 : 1;
+  wav.frames = data_size / stride;
+  wav.samples.resize(wav.frames * wav.channels);
+  for (size_t i=0; i<wav.frames; i++){
+    for (size_t c=0; c<wav.channels; c++){
+      wav.samples[i * wav.channels + c] = ToInt16(data + i * stride + c * bytes_per_sample, format, bits);
+    }
+  }
+  return true;
+}
+
+/// @brief Creates a stereo WAV file, the header is filled in on Close
+/// @param write_float True for 32 bit float, false for 16 bit PCM
+bool HostWavWriter::Open(const char *path, uint32_t sample_rate, bool write_float){
+  Close();
+  file_ = fopen(path, "wb");
+  if (!file_) return false;
+  sample_rate_ = sample_rate;
+  float_ = write_float;
+  frames_ = 0;
+  WriteHeader();
+  return true;
+}
+
+/// @brief Appends a block of stereo audio, clipped to +-1 for 16 bit files
+void HostWavWriter::Write(const float *left, const float *right, size_t size){
+  if (!file_) return;
+  if (float_){
+    float buf[2];
+    for (size_t i=0; i<size; i++){
+      buf[0] = left[i];
+      buf[1] = right[i];
+      fwrite(buf, sizeof(float), 2, file_);
+    }
+  }
+  else {
+    int16_t buf[2];
+    for (size_t i=0; i<size; i++){
+      const float in[2] = {left[i], right[i]};
+      for (size_t c=0; c<2; c++){
+        float s = roundf(in[c] * 32767.0f);
+        if (s > 32767.0f) s = 32767.0f;
+        if (s < -32768.0f) s = -32768.0f;
+        buf[c] = static_cast<int16_t>(s);
+      }
+      fwrite(buf, sizeof(int16_t), 2, file_);
+    }
+  }
+  frames_ += size;
+}
+
+/// @brief Writes the final sizes into the header and closes the file
+/// @return False if anything failed to write
+bool HostWavWriter::Close(){
+  if (!file_) return true;
+  fseek(file_, 0, SEEK_SET);
+  WriteHeader();
+  bool ok = ferror(file_) == 0;
+  ok = fclose(file_) == 0 && ok;
+  file_ = nullptr;
+  return ok;
+}
+
+void HostWavWriter::WriteHeader(){
+  const uint16_t channels = 2;
+  const uint16_t bits = float_ ? 32 : 16;
+  const uint16_t block_align = channels * bits / 8;
+  const uint32_t data_size = static_cast<uint32_t>(frames_ * block_align);
+  uint8_t hdr[44];
+  auto put32 = [&](size_t at, uint32_t v){ for (size_t i=0; i<4; i++) hdr[at+i] = (v >> (8*i)) & 0xFF; };
+  auto put16 = [&](size_t at, uint16_t v){ hdr[at] = v & 0xFF; hdr[at+1] = v >> 8; };
+  memcpy(hdr, "RIFF", 4);
+  put32(4, 36 + data_size);
+  memcpy(hdr + 8, "WAVEfmt ", 8);
+  put32(16, 16);
+  put16(20, float_ ? 3 : 1);
+  put16(22, channels);
+  put32(24, sample_rate_);
+  put32(28, sample_rate_ * block_align);
+  put16(32, block_align);
+  put16(34, bits);
+  memcpy(hdr + 36, "data", 4);
+  put32(40, data_size);
+  fwrite(hdr, 1, sizeof(hdr), file_);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/* WAV reading and writing for the host tools. Reads 16, 24 and 32 bit PCM
+  and 32 bit float, mono or stereo (any further channels are dropped), into
+  the interleaved int16 layout SampleStore uses. Writes stereo 16 bit PCM or
+  32 bit float */
+struct WavData {
+  std::vector<int16_t> samples;
+  size_t channels;
+  size_t frames;
+  uint32_t sample_rate;
+};
+
+bool ReadWav(const char *path, WavData &wav);
+
+class HostWavWriter {
+  public:
+    HostWavWriter() : file_(nullptr), float_(false), frames_(0) {}
+    ~HostWavWriter() { Close(); }
+
+    bool Open(const char *path, uint32_t sample_rate, bool write_float);
+    void Write(const float *left, const float *right, size_t size);
+    bool Close();
+
+  private:
+    void WriteHeader();
+
+    FILE *file_;
+    uint32_t sample_rate_;
+    bool float_;
+    size_t frames_;
+};
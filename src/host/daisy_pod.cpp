@@ -0,0 +1,107 @@
+#include "daisy_pod.h"
+#include <chrono>
+#include "HostSdCard.h"
+
+using namespace daisy;
+
+void System::Delay(uint32_t delay_ms){
+  HostPlatform::Get().Advance(delay_ms * 1000);
+}
+
+void System::DelayUs(uint32_t delay_us){
+  HostPlatform::Get().Advance(delay_us);
+}
+
+uint32_t System::GetNow(){
+  return HostPlatform::Get().NowMs();
+}
+
+uint32_t System::GetUs(){
+  return HostPlatform::Get().NowUs();
+}
+
+uint32_t System::GetTick(){
+  using namespace std::chrono;
+  return static_cast<uint32_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+void DaisySeed::SetLed(bool state){
+  HostPlatform::Get().Trace("seed led %s", state ? "on" : "off");
+}
+
+/// @brief Reads the switch and finds its edges. Polling it again within the same
+///        millisecond moves the clock on, so busy waits for a release end
+void Switch::Debounce(){
+  if (System::GetNow() == last_debounce_) System::Delay(1);
+  last_debounce_ = System::GetNow();
+  const bool was_pressed = pressed_;
+  pressed_ = HostPlatform::Get().SwitchDown(sw_);
+  rising_ = pressed_ && !was_pressed;
+  falling_ = was_pressed && !pressed_;
+  if (rising_) rising_time_ = last_debounce_;
+}
+
+void Encoder::Debounce(){
+  sw_.Debounce();
+  inc_ = HostPlatform::Get().TakeDetent();
+}
+
+float AnalogControl::Process(){
+  val_ = HostPlatform::Get().Knob(idx_);
+  return val_;
+}
+
+void RgbLed::Update(){
+  if (r_ == shown_[0] && g_ == shown_[1] && b_ == shown_[2]) return;
+  shown_[0] = r_;
+  shown_[1] = g_;
+  shown_[2] = b_;
+  HostPlatform::Get().Trace("%s %.2f %.2f %.2f", name_, r_, g_, b_);
+}
+
+/// @brief Opens the platform's disk image as the card
+SdmmcHandler::Result SdmmcHandler::Init(const Config &cfg){
+  const char *path = HostPlatform::Get().SdImagePath();
+  if (!OpenSdImage(path)){
+    fprintf(stderr, "can't open SD card image %s - make one with sd_image\n", path);
+    return Result::ERROR;
+  }
+  return Result::OK;
+}
+
+void DaisyPod::Init(bool boost){
+  HostPlatform::Get().Init();
+}
+
+void DaisyPod::StartAudio(AudioHandle::AudioCallback cb){
+  HostPlatform::Get().StartAudio(cb);
+}
+
+void DaisyPod::StopAudio(){
+  HostPlatform::Get().StopAudio();
+}
+
+void DaisyPod::SetAudioSampleRate(SaiHandle::Config::SampleRate samplerate){
+  if (samplerate != SaiHandle::Config::SampleRate::SAI_48KHZ){
+    fprintf(stderr, "warning: the host platform only runs at 48kHz\n");
+  }
+}
+
+void DaisyPod::SetAudioBlockSize(size_t blocksize){
+  HostPlatform::Get().SetBlockSize(blocksize);
+}
+
+size_t DaisyPod::AudioBlockSize(){
+  return HostPlatform::Get().BlockSize();
+}
+
+void DaisyPod::ProcessDigitalControls(){
+  encoder.Debounce();
+  button1.Debounce();
+  button2.Debounce();
+}
+
+void DaisyPod::UpdateLeds(){
+  led1.Update();
+  led2.Update();
+}
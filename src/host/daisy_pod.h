@@ -0,0 +1,181 @@
+#pragma once
+#include <stdio.h>
+#include <stdarg.h>
+#include "daisy_core.h"
+#include "sys/system.h"
+#include "hid/audio.h"
+#include "hid/midi.h"
+#include "util/wav_format.h"
+#include "util/WavWriter.h"
+#include "util/CpuLoadMeter.h"
+#include "util/color.h"
+#include "HostPlatform.h"
+
+/* Host stand-in for daisy_pod.h, found ahead of libDaisy's on the include
+  path. The Pod's controls, audio and SD card run on HostPlatform, everything
+  else is libDaisy's own - MIDI parsing, WavWriter over FatFs, CpuLoadMeter,
+  Color. The engine sources only use the seed's debug prints, so the offline
+  renderer builds against this without the platform. Prints go to stderr */
+
+/* SDRAM buffers become ordinary zeroed .bss, which the host maps in on first
+  touch the same as heap - the 56MB of sample buffers costs only what's used */
+#define DSY_SDRAM_BSS
+
+namespace daisy {
+
+class DaisySeed {
+  public:
+    void PrintLine(const char *format, ...){
+      va_list args;
+      va_start(args, format);
+      vfprintf(stderr, format, args);
+      va_end(args);
+      fputc('\n', stderr);
+    }
+    void Print(const char *format, ...){
+      va_list args;
+      va_start(args, format);
+      vfprintf(stderr, format, args);
+      va_end(args);
+    }
+    /* the log goes straight to stderr, there's nothing to wait for */
+    void StartLog(bool wait_for_pc = false) {}
+    void SetLed(bool state);
+};
+
+/* debounced switch, read from the platform's scripted state */
+class Switch {
+  public:
+    explicit Switch(HostSwitch sw) : sw_(sw) {}
+
+    void Debounce();
+    bool RisingEdge() const { return rising_; }
+    bool FallingEdge() const { return falling_; }
+    bool Pressed() const { return pressed_; }
+    float TimeHeldMs() const { return pressed_ ? static_cast<float>(System::GetNow() - rising_time_) : 0.0f; }
+
+  private:
+    HostSwitch sw_;
+    bool pressed_ = false;
+    bool rising_ = false;
+    bool falling_ = false;
+    uint32_t rising_time_ = 0;
+    uint32_t last_debounce_ = 0;
+};
+
+class Encoder {
+  public:
+    Encoder() : sw_(HostSwitch::Encoder) {}
+
+    /* one detent of the scripted turns per call, like the real quadrature decode */
+    void Debounce();
+    int32_t Increment() const { return inc_; }
+    bool RisingEdge() const { return sw_.RisingEdge(); }
+    bool FallingEdge() const { return sw_.FallingEdge(); }
+    bool Pressed() const { return sw_.Pressed(); }
+    float TimeHeldMs() const { return sw_.TimeHeldMs(); }
+
+  private:
+    Switch sw_;
+    int32_t inc_ = 0;
+};
+
+class AnalogControl {
+  public:
+    explicit AnalogControl(size_t idx) : idx_(idx) {}
+
+    float Process();
+    float Value() const { return val_; }
+
+  private:
+    size_t idx_;
+    float val_ = 0.0f;
+};
+
+class RgbLed {
+  public:
+    explicit RgbLed(const char *name) : name_(name) {}
+
+    void Set(float r, float g, float b){ r_ = r; g_ = g; b_ = b; }
+    void SetRed(float val){ r_ = val; }
+    void SetGreen(float val){ g_ = val; }
+    void SetBlue(float val){ b_ = val; }
+    void SetColor(Color c){ Set(c.Red(), c.Green(), c.Blue()); }
+    /* traces the colour when it changes */
+    void Update();
+
+  private:
+    const char *name_;
+    float r_ = 0.0f, g_ = 0.0f, b_ = 0.0f;
+    float shown_[3] = {-1.0f, -1.0f, -1.0f};
+};
+
+/* MIDI transport for MidiHandler, fed note events by the control script */
+class HostMidiTransport {
+  public:
+    typedef void (*MidiRxParseCallback)(uint8_t *data, size_t size, void *context);
+    struct Config {};
+
+    void Init(Config config) {}
+    void StartRx(MidiRxParseCallback parse_callback, void *context){
+      HostPlatform::Get().SetMidiInput(parse_callback, context);
+    }
+    bool RxActive() { return true; }
+    void FlushRx() {}
+    void Tx(uint8_t *buff, size_t size) {}
+};
+using MidiHostHandler = MidiHandler<HostMidiTransport>;
+
+/* the SD card is the platform's disk image, see HostSdCard.h */
+class SdmmcHandler {
+  public:
+    enum class Result { OK, ERROR };
+    struct Config {
+      void Defaults() {}
+    };
+    Result Init(const Config &cfg);
+};
+
+class DaisyPod {
+  public:
+    DaisyPod() : knob1(0), knob2(1), button1(HostSwitch::Button1), button2(HostSwitch::Button2),
+                 led1("led1"), led2("led2") {}
+
+    void Init(bool boost = false);
+    void DelayMs(size_t del){ System::Delay(del); }
+
+    void StartAudio(AudioHandle::AudioCallback cb);
+    void ChangeAudioCallback(AudioHandle::AudioCallback cb){ StartAudio(cb); }
+    void StopAudio();
+    /* only 48kHz, as the app runs */
+    void SetAudioSampleRate(SaiHandle::Config::SampleRate samplerate);
+    float AudioSampleRate(){ return 48000.0f; }
+    void SetAudioBlockSize(size_t blocksize);
+    size_t AudioBlockSize();
+    float AudioCallbackRate(){ return AudioSampleRate() / AudioBlockSize(); }
+
+    /* the knobs are read when processed, there's no ADC to run */
+    void StartAdc() {}
+    void StopAdc() {}
+    void ProcessAnalogControls(){ knob1.Process(); knob2.Process(); }
+    void ProcessDigitalControls();
+    void ProcessAllControls(){
+      ProcessAnalogControls();
+      ProcessDigitalControls();
+    }
+
+    void ClearLeds(){
+      led1.Set(0.0f, 0.0f, 0.0f);
+      led2.Set(0.0f, 0.0f, 0.0f);
+    }
+    void UpdateLeds();
+
+    DaisySeed seed;
+    Encoder encoder;
+    AnalogControl knob1, knob2;
+    Switch button1, button2;
+    RgbLed led1, led2;
+    MidiHostHandler midi;
+};
+
+}
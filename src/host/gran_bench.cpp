@@ -0,0 +1,526 @@
+/* Microbenchmarks for the audio hot path - the grain pool, each effect, the
+  whole FX chain, the synth feeding it and the app's whole synthesis callback -
+  across grain counts, pitch ratios and block sizes. The callback cases are
+  also split into a fixed cost per call and a cost per sample, which is what
+  a bigger AUDIO_BLOCK_SIZE saves. Prints ns per sample, samples per second
+  and the share of the 48kHz real time budget each takes, writes them as
+  JSON, and checks them against a baseline from an earlier run so a slowdown
+  fails the build. A case
+  that looks slower is timed again before it counts, as a busy machine can
+  make any one pass slow.
+
+  Timings are the fastest of several repeats of 100ms of audio, which is
+  what the code costs when nothing else gets in the way. Baselines only mean
+  something on the machine they were made on - remake bench_baseline.json
+  with `make bench-baseline` when the benchmark machine changes */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "GranularSynth.h"
+#include "GrainPool.h"
+#include "FxChain.h"
+#include "SynthParams.h"
+#include "ParamSnapshot.h"
+
+using namespace daisysp;
+
+constexpr float kBudgetNs = 1e9f / SAMPLE_RATE_FLOAT;
+/* frames timed per repeat, 100ms of audio - short repeats, so the fastest is more
+  likely to have run without interruption */
+constexpr size_t kBenchFrames = SAMPLE_RATE / 10;
+/* steal policy names for -p, in StealPolicy order */
+static const char *const kStealNames[] = {"none", "oldest", "quietest", "nearest_finish"};
+/* seconds of test audio the grains read from */
+constexpr size_t kSourceSeconds = 10;
+/* default allowed slowdown against the baseline, in percent */
+constexpr float kDefaultThreshold = 15.0f;
+/* times a case that looks slower than the baseline is timed again */
+constexpr size_t kConfirmRounds = 3;
+
+constexpr size_t kBlockSizes[] = {2, 16, 48, 128};
+constexpr size_t kPoolGrains[] = {1, 16, 64};
+constexpr float kPitchRatios[] = {0.5f, 1.0f, 1.5f, 2.0f};
+/* synth density knob settings - the cloud keeps up to MAX_TARGET_GRAINS playing */
+constexpr float kSynthDensities[] = {0.3f, 1.0f};
+constexpr float kSynthPitches[] = {0.5f, 1.0f, 2.0f};
+
+/* the reverb's delay lines are too big for the stack */
+static ReverbSc reverb;
+static FxChain fx(reverb);
+static MoogLadder moog;
+static Limiter limiter[2];
+static GrainSlabMemory pool_slabs, synth_slabs;
+static GrainPool<64> pool(pool_slabs);
+static daisy::DaisyPod pod;
+static GranularSynth synth(pod, synth_slabs);
+/* what the app's callback reads its knobs from and records into */
+static ParamSnapshot<SynthParams> knobs;
+static SynthParams applied;
+static WavWriter<16384> recorder;
+
+static std::vector<int16_t> source_buf;
+static std::vector<int16_t> mip_buf;
+static SampleStore store;
+static SampleMipMap mips;
+
+struct BenchCase {
+  std::string name;
+  size_t block;
+  /* gets the case ready, called before each repeat */
+  std::function<void()> setup;
+  /* renders one block into left and right */
+  std::function<void(float*, float*, size_t)> process;
+  /* grains playing after a block, for cases that have them */
+  std::function<size_t()> grains;
+  /* grain cache counters, for cases that trigger grains */
+  std::function<GrainCache::Stats()> cache;
+};
+
+struct BenchResult {
+  std::string name;
+  float ns_per_sample;
+  float samples_per_sec;
+  float budget_pct;
+  float grains;  /* mean playing grains, -1 if it doesn't apply */
+  /* grains staged, missed with every slab taken and missed on size, over the
+    untimed run - all 0 if it doesn't apply */
+  GrainCache::Stats cache;
+};
+
+/* small LCG for test signals and grain positions - the same every run */
+static uint32_t bench_rng = 1;
+static float BenchNoise(){
+  bench_rng = bench_rng * 1664525u + 1013904223u;
+  return static_cast<float>(bench_rng >> 8) / 8388608.0f - 1.0f;
+}
+
+/// @brief Fills the sample store with a stereo mix of tones and noise, and
+///        builds its mip-map, so pitched grains read real levels
+static void InitSource(){
+  const size_t frames = kSourceSeconds * SAMPLE_RATE;
+  source_buf.resize(frames * 2);
+  for (size_t i=0; i<frames; i++){
+    float t = static_cast<float>(i) / SAMPLE_RATE_FLOAT;
+    float tone = 0.4f * sinf(TWOPI_F * 220.0f * t) + 0.2f * sinf(TWOPI_F * 3310.0f * t);
+    source_buf[2*i] = f2s16(tone + 0.1f * BenchNoise());
+    source_buf[2*i+1] = f2s16(tone + 0.1f * BenchNoise());
+  }
+  store.Init(source_buf.data(), source_buf.size());
+  store.SetChannels(2);
+  store.SetLength(frames);
+  mip_buf.resize(source_buf.size() * 3 / 4 + 2);
+  mips.Init(mip_buf.data(), mip_buf.size());
+  mips.Build(&store, frames);
+}
+
+/* fills the block with test input for the effect cases */
+static void NoiseBlock(float *left, float *right, size_t size){
+  for (size_t i=0; i<size; i++){
+    left[i] = 0.5f * BenchNoise();
+    right[i] = 0.5f * BenchNoise();
+  }
+}
+
+/* keeps the pool playing num_grains grains, started across the source */
+static void TopUpPool(size_t num_grains, float pitch){
+  const size_t frames = kSourceSeconds * SAMPLE_RATE;
+  while (pool.ActiveCount() < num_grains){
+    size_t pos = static_cast<size_t>((BenchNoise() * 0.5f + 0.5f) * (frames / 2));
+    pool.Trigger(pos, MAX_GRAIN_SIZE_SAMPLES, pitch, WindowShape::Hann, 0, BenchNoise() * 0.5f + 0.5f);
+  }
+}
+
+static std::string CaseName(const char *kernel, const char *params, size_t block){
+  char name[96];
+  snprintf(name, sizeof(name), "%s%s/b%zu", kernel, params, block);
+  return name;
+}
+
+static std::vector<BenchCase> MakeCases(){
+  std::vector<BenchCase> cases;
+  char params[48];
+  for (size_t block : kBlockSizes){
+    /* the grain pool on its own */
+    for (size_t grains : kPoolGrains){
+      for (float pitch : kPitchRatios){
+        snprintf(params, sizeof(params), "/g%zu/p%.1f", grains, pitch);
+        cases.push_back({CaseName("pool", params, block), block,
+          [](){ pool.Init(&store, store.Length(), &mips); },
+          [grains, pitch](float *l, float *r, size_t n){
+            TopUpPool(grains, pitch);
+            memset(l, 0, n * sizeof(float));
+            memset(r, 0, n * sizeof(float));
+            pool.ProcessBlock(l, r, n);
+          },
+          [](){ return pool.ActiveCount(); },
+          [](){ return pool.CacheStats(); }});
+      }
+    }
+    /* each effect, then the chain as the app runs it */
+    cases.push_back({CaseName("moog", "", block), block,
+      [](){ moog.Init(SAMPLE_RATE_FLOAT); moog.SetFreq(2000.0f); moog.SetRes(0.4f); },
+      [](float *l, float *r, size_t n){
+        NoiseBlock(l, r, n);
+        for (size_t i=0; i<n; i++) l[i] = moog.Process(l[i]);
+      }, nullptr});
+    cases.push_back({CaseName("reverb", "", block), block,
+      [](){ reverb.Init(SAMPLE_RATE_FLOAT); reverb.SetFeedback(0.85f); reverb.SetLpFreq(10000.0f); },
+      [](float *l, float *r, size_t n){
+        NoiseBlock(l, r, n);
+        reverb.ProcessBlock(l, r, l, r, n);
+      }, nullptr});
+    cases.push_back({CaseName("limiter", "", block), block,
+      [](){ limiter[0].Init(); limiter[1].Init(); },
+      [](float *l, float *r, size_t n){
+        NoiseBlock(l, r, n);
+        limiter[0].ProcessBlock(l, n, 1.0f);
+        limiter[1].ProcessBlock(r, n, 1.0f);
+      }, nullptr});
+    cases.push_back({CaseName("fx_chain", "", block), block,
+      [](){
+        fx.Init(SAMPLE_RATE_FLOAT);
+        SynthParams p = kDefaultSynthParams;
+        p.reverb_feedback = p.reverb_mix = p.lowpass = p.hipass = 0.5f;
+        fx.SetParams(p, kDefaultSynthParams);
+      },
+      [](float *l, float *r, size_t n){
+        NoiseBlock(l, r, n);
+        fx.Update(n);
+        fx.ProcessBlock(l, r, n);
+      }, nullptr});
+    /* the whole synthesis path of the audio callback */
+    for (float density : kSynthDensities){
+      for (float pitch : kSynthPitches){
+        snprintf(params, sizeof(params), "/d%.1f/p%.1f", density, pitch);
+        cases.push_back({CaseName("synth_chain", params, block), block,
+          [density, pitch](){
+            synth.SetSeed(DEFAULT_RNG_SEED);
+            synth.Init(&store, store.Length(), &mips);
+            synth.SetGrainSize(1.0f);
+            synth.SetSpawnPos(0.3f);
+            synth.SetPanJitter(0.5f);
+            synth.SetDensity(density);
+            synth.SetPitchRatio((pitch - MIN_PITCH) / (MAX_PITCH - MIN_PITCH));
+            fx.Init(SAMPLE_RATE_FLOAT);
+            /* let the cloud fill before timing */
+            float l[128], r[128];
+            for (size_t i=0; i<3*SAMPLE_RATE; i+=128) synth.ProcessBlock(l, r, 128);
+          },
+          [](float *l, float *r, size_t n){
+            fx.Update(n);
+            synth.ProcessBlock(l, r, n);
+            fx.ProcessBlock(l, r, n);
+          },
+          [](){ return synth.GetActiveGrains(); },
+          [](){ return synth.GetCacheStats(); }});
+      }
+    }
+    /* the app's synthesis callback - the synth chain plus reading the knobs,
+      the load governor and recording the output, with a light cloud so the
+      fixed cost of each call stands out (see PrintCallbackCost) */
+    cases.push_back({CaseName("callback", "", block), block,
+      [](){
+        synth.SetSeed(DEFAULT_RNG_SEED);
+        synth.Init(&store, store.Length(), &mips);
+        synth.SetDensity(0.3f);
+        fx.Init(SAMPLE_RATE_FLOAT);
+        applied = kDefaultSynthParams;
+        SynthParams p = kDefaultSynthParams;
+        p.reverb_mix = p.reverb_feedback = 0.5f;
+        knobs.Publish(p);
+        WavWriter<16384>::Config cfg;
+        cfg.samplerate = SAMPLE_RATE_FLOAT;
+        cfg.channels = 2;
+        cfg.bitspersample = 16;
+        recorder.Init(cfg);
+      },
+      [](float *l, float *r, size_t n){
+        SynthParams p;
+        if (knobs.Read(p)){
+          synth.SetParams(p, applied);
+          fx.SetParams(p, applied);
+          applied = p;
+        }
+        fx.Update(n);
+        synth.ProcessBlock(l, r, n);
+        fx.ProcessBlock(l, r, n);
+        for (size_t i=0; i<n; i++){
+          float frame[2] = {l[i], r[i]};
+          recorder.Sample(frame);
+        }
+        synth.GovernLoad(0.3f, n);
+      },
+      [](){ return synth.GetActiveGrains(); },
+      [](){ return synth.GetCacheStats(); }});
+  }
+  return cases;
+}
+
+/// @brief Splits the callback cases' time into a fixed cost per call and a
+///        cost per sample - ns per sample is per_sample + per_call / block, so
+///        a line fitted through it against 1 / block gives both - and prints
+///        what share of the callback the fixed cost takes at each block size
+static void PrintCallbackCost(const std::vector<BenchResult> &results){
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  std::vector<size_t> blocks;
+  for (const BenchResult &r : results){
+    size_t block;
+    if (sscanf(r.name.c_str(), "callback/b%zu", &block) != 1) continue;
+    const double x = 1.0 / block;
+    blocks.push_back(block);
+    n++;
+    sx += x;
+    sy += r.ns_per_sample;
+    sxx += x * x;
+    sxy += x * r.ns_per_sample;
+  }
+  if (n < 2 || n * sxx == sx * sx) return;
+  const double per_call = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+  const double per_sample = (sy - per_call * sx) / n;
+  if (per_call <= 0.0){
+    printf("callback: no cost per call measurable over %.1f ns per sample\n", per_sample);
+    return;
+  }
+  printf("callback: %.0f ns per call + %.1f ns per sample - the per call share is", per_call, per_sample);
+  for (size_t block : blocks){
+    printf(" %.1f%% at b%zu", 100.0 * per_call / (per_call + per_sample * block), block);
+  }
+  printf("\n");
+}
+
+/// @brief Times one repeat of a case, from its setup
+/// @return Seconds taken to render kBenchFrames
+static double TimeCase(const BenchCase &c){
+  std::vector<float> left(c.block), right(c.block);
+  bench_rng = 1;
+  c.setup();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t frame=0; frame<kBenchFrames; frame+=c.block){
+    c.process(left.data(), right.data(), c.block);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief Mean grains playing over an untimed run of a case, -1 if it has none
+/// @param cache Set to the grain cache counters over the run
+static float CountGrains(const BenchCase &c, GrainCache::Stats &cache){
+  cache = {0, 0, 0};
+  if (!c.grains) return -1.0f;
+  std::vector<float> left(c.block), right(c.block);
+  bench_rng = 1;
+  c.setup();
+  /* the counters run from Init, so leave out what setup triggered */
+  const GrainCache::Stats start = c.cache();
+  size_t grain_sum = 0, blocks = 0;
+  for (size_t frame=0; frame<kBenchFrames; frame+=c.block){
+    c.process(left.data(), right.data(), c.block);
+    grain_sum += c.grains();
+    blocks++;
+  }
+  const GrainCache::Stats end = c.cache();
+  cache = {end.hits - start.hits, end.misses_full - start.misses_full, end.misses_size - start.misses_size};
+  return static_cast<float>(grain_sum) / blocks;
+}
+
+static bool WriteJson(const char *path, const std::vector<BenchResult> &results){
+  FILE *f = fopen(path, "w");
+  if (!f) return false;
+  fprintf(f, "{\n  \"sample_rate\": %d,\n  \"cases\": [\n", SAMPLE_RATE);
+  for (size_t i=0; i<results.size(); i++){
+    const BenchResult &r = results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"ns_per_sample\": %.3f, \"samples_per_sec\": %.0f, \"budget_pct\": %.4f",
+            r.name.c_str(), r.ns_per_sample, r.samples_per_sec, r.budget_pct);
+    if (r.grains >= 0.0f) fprintf(f, ", \"grains\": %.1f", r.grains);
+    fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0;
+}
+
+/* a baseline case - only the fields the comparison needs */
+struct BaselineCase {
+  std::string name;
+  float ns_per_sample;
+};
+
+/// @brief Reads the cases back from a file WriteJson wrote, one case per line
+static bool ReadBaseline(const char *path, std::vector<BaselineCase> &cases){
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[512];
+  while (fgets(line, sizeof(line), f)){
+    const char *name = strstr(line, "\"name\": \"");
+    const char *ns = strstr(line, "\"ns_per_sample\": ");
+    if (!name || !ns) continue;
+    name += strlen("\"name\": \"");
+    const char *end = strchr(name, '"');
+    if (!end) continue;
+    cases.push_back({std::string(name, end), strtof(ns + strlen("\"ns_per_sample\": "), nullptr)});
+  }
+  fclose(f);
+  return true;
+}
+
+static void Usage(){
+  fprintf(stderr,
+    "usage: gran_bench [options]\n"
+    "  -f TEXT  only run cases whose name contains TEXT, eg pool/g64 or /b2\n"
+    "  -n N     repeats of each case, the fastest counts - default 20\n"
+    "  -j FILE  write the results as JSON\n"
+    "  -c FILE  compare with a baseline written by -j, failing on slowdowns that\n"
+    "           are still there when the case is timed again\n"
+    "  -t PCT   slowdown allowed against the baseline - default %.0f%%\n"
+    "  -p NAME  steal policy of the pool and synth - none, oldest, quietest or\n"
+    "           nearest_finish, default quietest as in the app. Baselines are\n"
+    "           made with the default\n"
+    "  -l       list the cases\n",
+    kDefaultThreshold);
+}
+
+int main(int argc, char **argv){
+#ifdef __SSE__
+  /* flush denormals to zero, as in gran_render */
+  _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+  const char *filter = nullptr;
+  const char *json_path = nullptr;
+  const char *baseline_path = nullptr;
+  size_t repeats = 20;
+  float threshold = kDefaultThreshold;
+  bool list = false;
+  StealPolicy steal = StealPolicy::Quietest;
+  bool steal_ok = true;
+  for (int i=1; i<argc; i++){
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-f") == 0 && has_value) filter = argv[++i];
+    else if (strcmp(arg, "-n") == 0 && has_value) repeats = strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(arg, "-j") == 0 && has_value) json_path = argv[++i];
+    else if (strcmp(arg, "-c") == 0 && has_value) baseline_path = argv[++i];
+    else if (strcmp(arg, "-t") == 0 && has_value) threshold = strtof(argv[++i], nullptr);
+    else if (strcmp(arg, "-l") == 0) list = true;
+    else if (strcmp(arg, "-p") == 0 && has_value){
+      const char *name = argv[++i];
+      steal_ok = false;
+      for (size_t p=0; p<NUM_STEAL_POLICIES; p++){
+        if (strcmp(name, kStealNames[p]) == 0){
+          steal = static_cast<StealPolicy>(p);
+          steal_ok = true;
+        }
+      }
+    }
+    else {
+      Usage();
+      return 2;
+    }
+  }
+  if (repeats < 1 || !steal_ok){
+    Usage();
+    return 2;
+  }
+
+  std::vector<BaselineCase> baseline;
+  if (baseline_path && !ReadBaseline(baseline_path, baseline)){
+    fprintf(stderr, "can't read baseline %s\n", baseline_path);
+    return 1;
+  }
+
+  InitSource();
+  pool.SetStealPolicy(steal);
+  synth.SetStealPolicy(steal);
+  std::vector<BenchCase> cases;
+  for (BenchCase &c : MakeCases()){
+    if (filter && c.name.find(filter) == std::string::npos) continue;
+    if (list) printf("%s\n", c.name.c_str());
+    else cases.push_back(c);
+  }
+  if (list) return 0;
+
+  /* each repeat goes round every case, so a case's fastest time is taken
+    across the whole run rather than one stretch where the host was busy */
+  std::vector<double> best(cases.size(), 0.0);
+  for (size_t rep=0; rep<repeats; rep++){
+    for (size_t i=0; i<cases.size(); i++){
+      double secs = TimeCase(cases[i]);
+      if (rep == 0 || secs < best[i]) best[i] = secs;
+    }
+  }
+  auto ns_per_sample = [&](size_t i){
+    const size_t frames = (kBenchFrames + cases[i].block - 1) / cases[i].block * cases[i].block;
+    return static_cast<float>(best[i] * 1e9 / frames);
+  };
+
+  /* baseline time of each case, 0 if the baseline doesn't have it */
+  std::vector<float> base_ns(cases.size(), 0.0f);
+  for (size_t i=0; i<cases.size(); i++){
+    for (const BaselineCase &b : baseline){
+      if (b.name == cases[i].name) base_ns[i] = b.ns_per_sample;
+    }
+  }
+  auto too_slow = [&](size_t i){
+    return base_ns[i] > 0.0f && ns_per_sample(i) > base_ns[i] * (1.0f + threshold / 100.0f);
+  };
+  /* a slow case is timed again before it counts, so a moment the host was
+    busy isn't reported as a regression */
+  for (size_t round=0; round<kConfirmRounds; round++){
+    std::vector<size_t> slow;
+    for (size_t i=0; i<cases.size(); i++){
+      if (too_slow(i)) slow.push_back(i);
+    }
+    if (slow.empty()) break;
+    for (size_t rep=0; rep<repeats; rep++){
+      for (size_t i : slow) best[i] = std::min(best[i], TimeCase(cases[i]));
+    }
+  }
+
+  std::vector<BenchResult> results;
+  size_t regressions = 0;
+  printf("%-28s %10s %14s %9s %7s %19s %9s\n", "case", "ns/sample", "samples/sec", "budget%", "grains",
+         "cache hit/full/size", "vs base");
+  for (size_t i=0; i<cases.size(); i++){
+    BenchResult r;
+    r.name = cases[i].name;
+    r.ns_per_sample = ns_per_sample(i);
+    r.samples_per_sec = 1e9f / r.ns_per_sample;
+    r.budget_pct = 100.0f * r.ns_per_sample / kBudgetNs;
+    r.grains = CountGrains(cases[i], r.cache);
+    results.push_back(r);
+
+    char grains[16] = "-";
+    if (r.grains >= 0.0f) snprintf(grains, sizeof(grains), "%.1f", r.grains);
+    /* how many grains the cache staged, and missed because every slab was
+      taken or the grain was too long for one */
+    char cache[32] = "-";
+    if (r.grains >= 0.0f) snprintf(cache, sizeof(cache), "%zu/%zu/%zu", r.cache.hits, r.cache.misses_full, r.cache.misses_size);
+    char change[24] = "";
+    if (base_ns[i] > 0.0f){
+      const bool slower = too_slow(i);
+      regressions += slower;
+      snprintf(change, sizeof(change), "%+.1f%%%s", 100.0f * (r.ns_per_sample / base_ns[i] - 1.0f), slower ? " SLOW" : "");
+    }
+    printf("%-28s %10.2f %14.0f %9.3f %7s %19s %9s\n", r.name.c_str(), r.ns_per_sample, r.samples_per_sec,
+           r.budget_pct, grains, cache, change);
+  }
+
+  PrintCallbackCost(results);
+
+  if (json_path && !WriteJson(json_path, results)){
+    fprintf(stderr, "can't write %s\n", json_path);
+    return 1;
+  }
+  if (regressions){
+    printf("%zu case%s more than %.0f%% slower than %s\n", regressions, regressions == 1 ? "" : "s",
+           threshold, baseline_path);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,234 @@
+/* Offline renderer - runs the grain engine and FX chain over a WAV file on
+  the host, following a parameter timeline, as fast as the CPU allows.
+  Used to batch render presets for listening tests and to measure engine
+  throughput. See Timeline.h for the timeline format */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "GranularSynth.h"
+#include "FxChain.h"
+#include "ChordMode.h"
+#include "SynthParams.h"
+#include "WavFile.h"
+#include "Timeline.h"
+#include "StageProfiler.h"
+
+/* the reverb's delay lines are too big for the stack */
+static daisysp::ReverbSc reverb;
+static daisy::DaisyPod pod;
+static GrainSlabMemory grain_slabs;
+static GranularSynth synth(pod, grain_slabs);
+static FxChain fx(reverb);
+static ChordMode chord_gen;
+
+/* seconds rendered past the last timeline event, so the tail is heard */
+constexpr float kTailSeconds = 2.0f;
+/* largest block the renderer runs - onsets are block offsets, see GrainScheduler */
+constexpr size_t kMaxBlock = 4096;
+
+static void Usage(){
+  fprintf(stderr,
+    "usage: gran_render [options] in.wav out.wav\n"
+    "  -t FILE  parameter timeline, see Timeline.h\n"
+    "  -d SEC   seconds to render - default the timeline plus %.0fs, or the length of in.wav\n"
+    "  -b N     block size, 1-%zu - default %zu as on the Pod\n"
+    "  -s SEED  random seed - the same seed renders the same output\n"
+    "  -f       write 32 bit float instead of 16 bit\n"
+    "  -q       don't print the render speed, steal count and cache counters\n"
+    "While a chord plays no cloud grains start, as in the app's chord mode\n",
+    kTailSeconds, kMaxBlock, BLOCK_SIZE);
+}
+
+/// @brief Applies one timeline event to the knob parameters or the synth
+static void ApplyEvent(const TimelineEvent &e, SynthParams &p){
+  switch (e.control){
+    case TimelineControl::GrainSize: p.grain_size = e.value; break;
+    case TimelineControl::SpawnPos: p.spawn_pos = e.value; break;
+    case TimelineControl::Pitch: p.pitch = e.value; break;
+    case TimelineControl::Density: p.density = e.value; break;
+    case TimelineControl::Pan: p.pan = e.value; break;
+    case TimelineControl::PanWidth: p.pan_width = e.value; break;
+    case TimelineControl::WindowTaper: p.window_taper = e.value; break;
+    case TimelineControl::ReverbFeedback: p.reverb_feedback = e.value; break;
+    case TimelineControl::ReverbMix: p.reverb_mix = e.value; break;
+    case TimelineControl::Lowpass: p.lowpass = e.value; break;
+    case TimelineControl::Hipass: p.hipass = e.value; break;
+    case TimelineControl::Window:
+      synth.SetWindowShape(static_cast<WindowShape>(static_cast<size_t>(e.value) % NUM_WINDOW_SHAPES));
+      break;
+    case TimelineControl::Scheduler:
+      synth.SetSchedulerMode(e.value > 0.0f ? SchedulerMode::Async : SchedulerMode::Sync);
+      break;
+    case TimelineControl::Steal:
+      synth.SetStealPolicy(static_cast<StealPolicy>(static_cast<size_t>(e.value) % NUM_STEAL_POLICIES));
+      break;
+    case TimelineControl::Chord: {
+      size_t chord = static_cast<size_t>(e.value) % static_cast<size_t>(ChordType::NUM_CHORDS);
+      chord_gen.SetChord(static_cast<ChordType>(chord));
+      if (!synth.EnqueueChord(chord_gen.GetRatios(0))) fprintf(stderr, "chord queue full, chord dropped\n");
+      break;
+    }
+    case TimelineControl::Key: chord_gen.SetKey(static_cast<size_t>(e.value)); break;
+    case TimelineControl::Inversion: chord_gen.SetInversion(static_cast<size_t>(e.value)); break;
+    case TimelineControl::Tuning: chord_gen.SetTuning(e.value > 0.0f ? Tuning::Just : Tuning::Equal); break;
+    case TimelineControl::NoteOn:
+      synth.PostNoteOn(static_cast<uint8_t>(e.value), static_cast<uint8_t>(e.value2));
+      break;
+    case TimelineControl::NoteOff: synth.PostNoteOff(static_cast<uint8_t>(e.value)); break;
+  }
+}
+
+#ifdef STAGE_PROFILER
+/// @brief Prints what each engine stage cost per block, as the app does
+static void PrintStages(size_t block){
+  const float budget = static_cast<float>(stage_profiler.TicksPerSecond()) * block / SAMPLE_RATE_FLOAT;
+  printf("stage      blocks      min      avg      p99      max  p99%%\n");
+  for (size_t i=0; i<StageProfiler::kNumStages; i++){
+    ProfileStage stage = static_cast<ProfileStage>(i);
+    StageStats stats;
+    if (!stage_profiler.Read(stage, stats)) continue;
+    printf("%-8s %8u %8u %8u %8u %8u %5.1f\n", StageProfiler::StageName(stage), stats.blocks,
+           stats.min, stats.avg, stats.p99, stats.max, 100.0f * stats.p99 / budget);
+  }
+}
+#endif
+
+int main(int argc, char **argv){
+#ifdef __SSE__
+  /* flush denormals to zero (FTZ and DAZ). The Pod's FPU handles them at full
+    speed, but on x86 the decaying filter and reverb tails crawl and would
+    make the throughput figures meaningless */
+  _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+  const char *timeline_path = nullptr;
+  const char *paths[2] = {nullptr, nullptr};
+  size_t num_paths = 0;
+  float seconds = -1.0f;
+  size_t block = BLOCK_SIZE;
+  uint32_t seed = DEFAULT_RNG_SEED;
+  bool write_float = false;
+  bool quiet = false;
+  for (int i=1; i<argc; i++){
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "-t") == 0 && has_value) timeline_path = argv[++i];
+    else if (strcmp(arg, "-d") == 0 && has_value) seconds = strtof(argv[++i], nullptr);
+    else if (strcmp(arg, "-b") == 0 && has_value) block = strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(arg, "-s") == 0 && has_value) seed = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(arg, "-f") == 0) write_float = true;
+    else if (strcmp(arg, "-q") == 0) quiet = true;
+    else if (arg[0] != '-' && num_paths < 2) paths[num_paths++] = arg;
+    else {
+      Usage();
+      return 2;
+    }
+  }
+  if (num_paths != 2 || block < 1 || block > kMaxBlock){
+    Usage();
+    return 2;
+  }
+
+  WavData wav;
+  if (!ReadWav(paths[0], wav) || wav.frames == 0){
+    fprintf(stderr, "can't read %s - needs 16/24/32 bit PCM or float WAV\n", paths[0]);
+    return 1;
+  }
+  if (wav.sample_rate != SAMPLE_RATE){
+    fprintf(stderr, "warning: %s is %uHz, it plays as if it were %dHz\n", paths[0], wav.sample_rate, SAMPLE_RATE);
+  }
+  Timeline timeline;
+  if (timeline_path){
+    std::string error;
+    if (!timeline.Load(timeline_path, SAMPLE_RATE_FLOAT, error)){
+      fprintf(stderr, "%s: %s\n", timeline_path, error.c_str());
+      return 1;
+    }
+  }
+  size_t total = seconds >= 0.0f ? static_cast<size_t>(seconds * SAMPLE_RATE_FLOAT)
+               : timeline_path ? timeline.EndFrame() + static_cast<size_t>(kTailSeconds * SAMPLE_RATE_FLOAT)
+               : wav.frames;
+
+  /* the audio, and its mip-map levels in 3/4 of the space, as the app lays them out */
+  SampleStore store;
+  store.Init(wav.samples.data(), wav.samples.size());
+  store.SetChannels(wav.channels);
+  store.SetLength(wav.frames);
+  std::vector<int16_t> mip_buf(wav.samples.size() * 3 / 4 + wav.channels);
+  SampleMipMap mips;
+  mips.Init(mip_buf.data(), mip_buf.size());
+  mips.Build(&store, wav.frames);
+
+  synth.SetSeed(seed);
+  synth.Init(&store, wav.frames, &mips);
+  fx.Init(SAMPLE_RATE_FLOAT);
+
+  /* the app starts from the default knob values without applying them */
+  SynthParams params = kDefaultSynthParams;
+  SynthParams applied = params;
+  const std::vector<TimelineEvent> &events = timeline.Events();
+  size_t next_event = 0;
+  /* render into memory and write the file afterwards, so only the engine is timed */
+  std::vector<float> out_left(total), out_right(total);
+
+#ifdef STAGE_PROFILER
+  stage_profiler.Init();
+#endif
+  auto start = std::chrono::steady_clock::now();
+  for (size_t frame=0; frame<total; frame+=block){
+    const size_t size = block < total - frame ? block : total - frame;
+    float *left = &out_left[frame];
+    float *right = &out_right[frame];
+    /* like knob moves on the Pod, events land at the start of a block */
+    while (next_event < events.size() && events[next_event].frame <= frame){
+      ApplyEvent(events[next_event++], params);
+    }
+    synth.SetParams(params, applied);
+    fx.SetParams(params, applied);
+    applied = params;
+    fx.Update(size);
+    if (synth.ChordActive() || !synth.ChordQueueEmpty()){
+      if (!synth.ChordActive()) synth.TriggerChord();
+      synth.ProcessChordBlock(left, right, size);
+    }
+    else {
+      synth.ProcessBlock(left, right, size);
+    }
+    fx.ProcessBlock(left, right, size);
+#ifdef STAGE_PROFILER
+    stage_profiler.EndBlock();
+#endif
+  }
+  const double render_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  HostWavWriter writer;
+  if (!writer.Open(paths[1], SAMPLE_RATE, write_float)){
+    fprintf(stderr, "can't write %s\n", paths[1]);
+    return 1;
+  }
+  writer.Write(out_left.data(), out_right.data(), total);
+  if (!writer.Close()){
+    fprintf(stderr, "failed writing %s\n", paths[1]);
+    return 1;
+  }
+
+  if (!quiet){
+    const double audio_secs = static_cast<double>(total) / SAMPLE_RATE_FLOAT;
+    const double rate = render_secs > 0.0 ? static_cast<double>(total) / render_secs : 0.0;
+    printf("rendered %.2fs in %.3fs, block %zu: %.0f samples/sec, %.1fx realtime\n",
+           audio_secs, render_secs, block, rate, rate / SAMPLE_RATE_FLOAT);
+    printf("%zu grains stolen\n", synth.GetStealCount());
+    const GrainCache::Stats &cache = synth.GetCacheStats();
+    printf("grain cache: %zu hits, %zu misses with every slab taken, %zu too long for a slab\n",
+           cache.hits, cache.misses_full, cache.misses_size);
+#ifdef STAGE_PROFILER
+    PrintStages(block);
+#endif
+  }
+  return 0;
+}
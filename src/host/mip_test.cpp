@@ -0,0 +1,71 @@
+/* Checks that grains pitched up read a mip-map level that keeps them from
+  aliasing. A 16kHz tone played at 1.9x lands past Nyquist and, read from the
+  full band store, folds back to 17.6kHz at close to full level - from
+  level 1, whose half-band filter has already removed it, almost nothing is
+  left. A 4kHz tone at 1.9x, and the 16kHz tone at 1x, are rendered as
+  references that should come through at full level. Exits 1 on failure */
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "GrainPool.h"
+#include "SampleMipMap.h"
+
+constexpr float kSampleRate = 48000.0f;
+constexpr size_t kSourceFrames = 48000;
+constexpr size_t kGrainSize = 9600;
+/* the alias has to be at least 30dB under the references */
+constexpr float kMaxAliasRatio = 0.03f;
+
+static GrainSlabMemory slabs;
+static GrainPool<4> pool(slabs);
+
+/// @brief Plays one grain of a stereo sine through the pool, reading the
+///        mip-map built from it
+/// @return RMS of the left output over the whole grain
+static float RenderRms(float tone_hz, float pitch){
+  std::vector<int16_t> source(kSourceFrames * 2);
+  for (size_t i=0; i<kSourceFrames; i++){
+    float s = 0.5f * sinf(2.0f * static_cast<float>(M_PI) * tone_hz * i / kSampleRate);
+    source[2*i] = source[2*i+1] = static_cast<int16_t>(s * 32767.0f);
+  }
+  SampleStore store;
+  store.Init(source.data(), source.size());
+  store.SetChannels(2);
+  store.SetLength(kSourceFrames);
+  std::vector<int16_t> mip_buf(source.size() * 3 / 4 + 2);
+  SampleMipMap mips;
+  mips.Init(mip_buf.data(), mip_buf.size());
+  mips.Build(&store, kSourceFrames);
+
+  pool.Init(&store, kSourceFrames, &mips);
+  pool.Trigger(kSourceFrames / 4, kGrainSize, pitch, WindowShape::Hann);
+  double sum = 0.0;
+  size_t frames = 0;
+  float left[64], right[64];
+  while (pool.ActiveCount() > 0){
+    for (size_t i=0; i<64; i++) left[i] = right[i] = 0.0f;
+    pool.ProcessBlock(left, right, 64);
+    for (size_t i=0; i<64; i++) sum += static_cast<double>(left[i]) * left[i];
+    frames += 64;
+  }
+  return static_cast<float>(sqrt(sum / frames));
+}
+
+int main(){
+  const float alias = RenderRms(16000.0f, 1.9f);
+  const float passed = RenderRms(4000.0f, 1.9f);
+  const float unpitched = RenderRms(16000.0f, 1.0f);
+  printf("mip_test: 16kHz at 1.9x %.5f, 4kHz at 1.9x %.5f, 16kHz at 1x %.5f\n", alias, passed, unpitched);
+  bool ok = true;
+  if (alias > kMaxAliasRatio * passed){
+    fprintf(stderr, "mip_test: a grain at 1.9x aliases - it isn't reading a decimated level\n");
+    ok = false;
+  }
+  if (unpitched < 0.5f * passed){
+    fprintf(stderr, "mip_test: a grain at 1x lost its top octave - it should read level 0\n");
+    ok = false;
+  }
+  printf("mip_test: %s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+/* SD card images for the host platform - formats a FAT image, copies WAV files
+  onto it and takes recordings back off, through the same FatFs build and
+  image driver the app uses */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "sys/fatfs.h"
+#include "HostSdCard.h"
+
+using namespace daisy;
+
+static FatFSInterface fsi;
+
+/* default size of a new image - big enough for FAT32, and sparse on disk */
+constexpr size_t kDefaultImageMB = 256;
+
+static void Usage(){
+  fprintf(stderr,
+    "usage: sd_image create IMAGE [-s MB] [FILE...]   new image, %zuMB by default\n"
+    "       sd_image add IMAGE FILE...                 copy files to the root\n"
+    "       sd_image ls IMAGE                          list the root\n"
+    "       sd_image get IMAGE NAME [OUT]              copy a file off, to NAME by default\n",
+    kDefaultImageMB);
+}
+
+/* name of a host path on the card - its last component */
+static const char* BaseName(const char *path){
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+static bool Mount(){
+  if (fsi.Init(FatFSInterface::Config::MEDIA_SD) != FatFSInterface::Result::OK) return false;
+  return f_mount(&fsi.GetSDFileSystem(), fsi.GetSDPath(), 1) == FR_OK;
+}
+
+static bool Format(){
+  if (fsi.Init(FatFSInterface::Config::MEDIA_SD) != FatFSInterface::Result::OK) return false;
+  std::vector<uint8_t> work(_MAX_SS * 64);
+  FRESULT res = f_mkfs(fsi.GetSDPath(), FM_ANY, 0, work.data(), work.size());
+  if (res != FR_OK){
+    fprintf(stderr, "format failed (%d)\n", res);
+    return false;
+  }
+  fsi.DeInit();
+  return Mount();
+}
+
+static bool AddFile(const char *path){
+  FILE *in = fopen(path, "rb");
+  if (!in){
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  FIL out;
+  bool ok = f_open(&out, BaseName(path), FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+  if (!ok) fprintf(stderr, "can't create %s on the card\n", BaseName(path));
+  char buf[16384];
+  size_t n;
+  while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0){
+    UINT written;
+    ok = f_write(&out, buf, n, &written) == FR_OK && written == n;
+    if (!ok) fprintf(stderr, "failed writing %s - is the card full?\n", BaseName(path));
+  }
+  fclose(in);
+  return f_close(&out) == FR_OK && ok;
+}
+
+static bool GetFile(const char *name, const char *path){
+  FIL in;
+  if (f_open(&in, name, FA_READ | FA_OPEN_EXISTING) != FR_OK){
+    fprintf(stderr, "no %s on the card\n", name);
+    return false;
+  }
+  FILE *out = fopen(path, "wb");
+  bool ok = out != nullptr;
+  if (!ok) fprintf(stderr, "can't write %s\n", path);
+  char buf[16384];
+  UINT n = 0;
+  while (ok && f_read(&in, buf, sizeof(buf), &n) == FR_OK && n > 0){
+    ok = fwrite(buf, 1, n, out) == n;
+  }
+  f_close(&in);
+  if (out) ok = fclose(out) == 0 && ok;
+  return ok;
+}
+
+static bool List(){
+  DIR dir;
+  FILINFO fno;
+  if (f_opendir(&dir, fsi.GetSDPath()) != FR_OK) return false;
+  while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0){
+    printf("%10lu  %s%s\n", static_cast<unsigned long>(fno.fsize), fno.fname, (fno.fattrib & AM_DIR) ? "/" : "");
+  }
+  f_closedir(&dir);
+  return true;
+}
+
+int main(int argc, char **argv){
+  if (argc < 3){
+    Usage();
+    return 2;
+  }
+  const char *cmd = argv[1];
+  const char *image = argv[2];
+  bool ok;
+  if (strcmp(cmd, "create") == 0){
+    size_t mb = kDefaultImageMB;
+    int first = 3;
+    if (argc > 4 && strcmp(argv[3], "-s") == 0){
+      mb = strtoul(argv[4], nullptr, 10);
+      first = 5;
+    }
+    if (mb == 0){
+      Usage();
+      return 2;
+    }
+    ok = OpenSdImage(image, mb * 1024 * 1024) && Format();
+    for (int i=first; ok && i<argc; i++) ok = AddFile(argv[i]);
+  }
+  else if (strcmp(cmd, "add") == 0 && argc > 3){
+    ok = OpenSdImage(image) && Mount();
+    for (int i=3; ok && i<argc; i++) ok = AddFile(argv[i]);
+  }
+  else if (strcmp(cmd, "ls") == 0){
+    ok = OpenSdImage(image) && Mount() && List();
+  }
+  else if (strcmp(cmd, "get") == 0 && argc > 3){
+    ok = OpenSdImage(image) && Mount() && GetFile(argv[3], argc > 4 ? argv[4] : argv[3]);
+  }
+  else {
+    Usage();
+    return 2;
+  }
+  if (!ok && !SdImageOpen()) fprintf(stderr, "can't open %s\n", image);
+  f_mount(nullptr, fsi.GetSDPath(), 0);
+  CloseSdImage();
+  return ok ? 0 : 1;
+}
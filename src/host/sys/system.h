@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+/* Host stand-in for libDaisy's sys/system.h, found ahead of it on the include
+  path. Time is simulated - GetNow and GetUs follow the platform clock, which
+  only moves on Delay (see HostPlatform), so a run gives the same result
+  however fast the host is. GetTick is the one real clock, a nanosecond
+  counter, so CpuLoadMeter measures what the audio callback actually costs */
+namespace daisy {
+
+class System {
+  public:
+    static void Delay(uint32_t delay_ms);
+    static void DelayUs(uint32_t delay_us);
+
+    static uint32_t GetNow();
+    static uint32_t GetUs();
+    static uint32_t GetTick();
+    static uint32_t GetTickFreq() { return 1000000000; }
+};
+
+}
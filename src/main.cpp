@@ -18,9 +18,10 @@ using namespace daisy;
 using namespace daisysp;
 using namespace std;
 
-/* SDRAM buffers for storing WAV files or recorded input audio */
-DSY_SDRAM_BSS alignas(16) int16_t left_buf[CHNL_BUF_SIZE_SAMPS];
-DSY_SDRAM_BSS alignas(16) int16_t right_buf[CHNL_BUF_SIZE_SAMPS];
+/* SDRAM buffer for storing WAV files or recorded input audio, interleaved */
+DSY_SDRAM_BSS alignas(32) int16_t sample_buf[SAMPLE_BUF_SIZE_SAMPS];
+/* SDRAM buffer for the 2x and 4x decimated copies of the audio */
+DSY_SDRAM_BSS alignas(32) int16_t mip_buf[MIP_BUF_SIZE_SAMPS];
 
 /* hardware interfaces */
 SdmmcHandler sd;
@@ -29,20 +30,19 @@ DaisyPod pod;
 FIL file;
 
 DSY_SDRAM_BSS ReverbSc reverb;
+/* grain cache staging slabs, in D2 SRAM */
+GRAIN_SLAB_BSS GrainSlabMemory grain_slabs;
 /* software classes to run app */
 AudioFileManager filemgr(sd, fsi, pod, &file);
-static GranularSynth synth(pod);
+static GranularSynth synth(pod, grain_slabs);
 GrannyChordApp app(pod, synth, filemgr, reverb);
 
-/* we set rng state here so we can use RNG fns across classes */
-uint32_t rng_state;
-
 int main (void){
   pod.Init();
-  #ifdef DEBUG_MODE
+  #if defined(DEBUG_MODE) || defined(STAGE_PROFILER)
   pod.seed.StartLog(true);
   #endif
 
-  app.Init(left_buf, right_buf);
+  app.Init(sample_buf, SAMPLE_BUF_SIZE_SAMPS, mip_buf, MIP_BUF_SIZE_SAMPS);
   app.Run();
 }
\ No newline at end of file